@@ -15,7 +15,8 @@ const PositionType CBandedSmithWaterman::Position_REF_AND_QUERO_NONZERO = 3;
 
 // constructor
 CBandedSmithWaterman::CBandedSmithWaterman(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty, unsigned int bandWidth) 
-: mCurrentMatrixSize(0)
+: BestScore(0.0f)
+, mCurrentMatrixSize(0)
 , mCurrentAnchorSize(0)
 , mCurrentAQSumSize(0)
 , mBandwidth(bandWidth)
@@ -195,6 +196,8 @@ void CBandedSmithWaterman::Align(unsigned int& referenceAl, string& cigarAl, con
 
 	Traceback(referenceAl, cigarAl, s1, s2, bestRow, bestColumn, rowOffset, columnOffset);
 
+	// no cell is scored when the band misses the matrix
+	BestScore = max(bestScore, 0.0f);
 }
 
 // calculates the score during the forward algorithm
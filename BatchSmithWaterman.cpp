@@ -0,0 +1,194 @@
+#include "BatchSmithWaterman.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "SimdKernels.h"
+#include "SimdVectors.h"
+
+// ===========
+// the aligner
+// ===========
+
+CBatchSmithWaterman::CBatchSmithWaterman(const float* pScoringMatrix, float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty)
+    : mpKernels(GetSimdKernels())
+    , mpScoringMatrix(pScoringMatrix)
+    , mMatchScore(matchScore)
+    , mMismatchScore(mismatchScore)
+    , mGapOpenPenalty(gapOpenPenalty)
+    , mGapExtendPenalty(gapExtendPenalty)
+    , mCurrentWorkspaceSize(0)
+    , mCurrentTracebackSize(0)
+    , mWorkspace(NULL)
+    , mTraceback(NULL)
+    , mMaxQueryLength(1)
+    , mNumLanes(1)
+{}
+
+CBatchSmithWaterman::~CBatchSmithWaterman(void) {
+#if defined(SIMD_VECTORS)
+    if(mWorkspace) _mm_free(mWorkspace);
+#endif
+    if(mTraceback) delete [] mTraceback;
+}
+
+// returns true if a SIMD kernel can be used on this CPU
+bool CBatchSmithWaterman::IsAvailable(void) {
+    return GetSimdKernels() != NULL;
+}
+
+// replaces the scoring parameters
+void CBatchSmithWaterman::SetScores(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty) {
+    mMatchScore       = matchScore;
+    mMismatchScore    = mismatchScore;
+    mGapOpenPenalty   = gapOpenPenalty;
+    mGapExtendPenalty = gapExtendPenalty;
+}
+
+// returns true if the gap penalties can be handled by the batch kernels
+bool CBatchSmithWaterman::IsSupported(void) const {
+    // the 16-bit score bound relies on gaps never increasing a score
+    return (mGapOpenPenalty >= 0.0f) && (mGapExtendPenalty >= 0.0f);
+}
+
+// returns the maximum number of pairs that a single fill can hold
+unsigned int CBatchSmithWaterman::GetMaxBatchSize(void) {
+    const CSimdKernels* pKernels = GetSimdKernels();
+    return pKernels ? pKernels->ShortLanes : 1;
+}
+
+// fills the packed traceback matrices of up to GetMaxBatchSize() pairs and locates their best cells
+unsigned int CBatchSmithWaterman::Fill(const string** references, const string** queries, const unsigned int numPairs, float* bestScores, unsigned int* bestRows, unsigned int* bestColumns) {
+
+#if defined(SIMD_VECTORS)
+
+    if(!mpKernels) {
+	printf("ERROR: The batch Smith-Waterman algorithm is not available on this CPU.\n");
+	exit(1);
+    }
+
+    // the 16-bit lanes must hold every pair of the batch
+    unsigned int numShortPairs = min(numPairs, mpKernels->ShortLanes);
+    unsigned int maxLength = 0;
+    for(unsigned int k = 0; k < numShortPairs; k++) maxLength = max(maxLength, (unsigned int)min(references[k]->length(), queries[k]->length()));
+    unsigned int maxShortQueryLength = 0;
+    for(unsigned int k = 0; k < numShortPairs; k++) maxShortQueryLength = max(maxShortQueryLength, (unsigned int)queries[k]->length());
+
+    // the column of the best cell is tracked in the score lanes as well
+    const bool useShortScores = SimdShortScoresFit(mMatchScore, mMismatchScore, mGapOpenPenalty, mGapExtendPenalty, maxLength) && (maxShortQueryLength < 32768);
+
+    const unsigned int numLanes   = useShortScores ? mpKernels->ShortLanes : mpKernels->FloatLanes;
+    const unsigned int vectorSize = useShortScores ? mpKernels->ShortVectorSize : mpKernels->FloatVectorSize;
+    const unsigned int batchSize  = min(numPairs, numLanes);
+
+    // the kernels see the sequences as plain character arrays
+    const char*  referenceData[64];
+    const char*  queryData[64];
+    unsigned int referenceLengths[64];
+    unsigned int queryLengths[64];
+
+    unsigned int maxReferenceLength = 0;
+    unsigned int maxQueryLength     = 0;
+    for(unsigned int k = 0; k < batchSize; k++) {
+	if((references[k]->length() == 0) || (queries[k]->length() == 0)) {
+	    cout << "ERROR: Found a read with a zero length." << endl;
+	    exit(1);
+	}
+	referenceData[k]    = references[k]->data();
+	queryData[k]        = queries[k]->data();
+	referenceLengths[k] = references[k]->length();
+	queryLengths[k]     = queries[k]->length();
+	maxReferenceLength = max(maxReferenceLength, referenceLengths[k]);
+	maxQueryLength     = max(maxQueryLength, queryLengths[k]);
+    }
+
+    // collect the distinct reference symbols, each gets a query profile row
+    unsigned char symbols[256];
+    unsigned char symbolRows[256];
+    bool seen[256];
+    memset(seen, 0, sizeof(seen));
+    memset(symbolRows, 0, sizeof(symbolRows));
+    unsigned int numSymbols = 0;
+    for(unsigned int k = 0; k < batchSize; k++) {
+	const string& reference = *references[k];
+	for(unsigned int i = 0; i < reference.length(); i++) {
+	    const unsigned char c = reference[i];
+	    if(!seen[c]) {
+		seen[c]             = true;
+		symbolRows[c]       = numSymbols;
+		symbols[numSymbols] = c;
+		numSymbols++;
+	    }
+	}
+    }
+
+    // reinitialize our workspace and traceback matrix
+    const unsigned int workspaceSize = ((numSymbols + 5) * maxQueryLength + numSymbols + 5) * vectorSize;
+    if(workspaceSize > mCurrentWorkspaceSize) {
+	if(mWorkspace) _mm_free(mWorkspace);
+	mCurrentWorkspaceSize = workspaceSize;
+	mWorkspace = (char*)_mm_malloc(mCurrentWorkspaceSize, 64);
+	if(!mWorkspace) {
+	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
+	    exit(1);
+	}
+    }
+
+    const unsigned int tracebackSize = maxReferenceLength * maxQueryLength * numLanes;
+    if(tracebackSize > mCurrentTracebackSize) {
+	if(mTraceback) delete [] mTraceback;
+	mCurrentTracebackSize = tracebackSize;
+	try {
+	    mTraceback = new char[mCurrentTracebackSize];
+	} catch(bad_alloc) {
+	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
+	    exit(1);
+	}
+    }
+
+    CBatchFillParameters p;
+    p.References         = referenceData;
+    p.ReferenceLengths   = referenceLengths;
+    p.Queries            = queryData;
+    p.QueryLengths       = queryLengths;
+    p.NumPairs           = batchSize;
+    p.MaxReferenceLength = maxReferenceLength;
+    p.MaxQueryLength     = maxQueryLength;
+    p.ScoringMatrix      = mpScoringMatrix;
+    p.GapOpenPenalty     = mGapOpenPenalty;
+    p.GapExtendPenalty   = mGapExtendPenalty;
+    p.Symbols            = symbols;
+    p.NumSymbols         = numSymbols;
+    p.SymbolRows         = symbolRows;
+    p.Workspace          = mWorkspace;
+    p.Traceback          = mTraceback;
+
+    mpKernels->BatchFill[useShortScores](p, bestScores, bestRows, bestColumns);
+
+    mMaxQueryLength = maxQueryLength;
+    mNumLanes       = numLanes;
+
+    return batchSize;
+
+#else
+    printf("ERROR: The batch Smith-Waterman algorithm is not available in this build.\n");
+    exit(1);
+#endif
+}
+
+// returns a view of the packed traceback matrix of the given pair of the last fill
+CPackedTracebackMatrix CBatchSmithWaterman::GetTracebackMatrix(const unsigned int pair) const {
+    // the lanes are interleaved cell by cell, so each pair is a plain row-major matrix with a lane stride
+    CPackedTracebackMatrix matrix;
+    matrix.Cells         = mTraceback + pair;
+    matrix.RowStride     = mMaxQueryLength * mNumLanes;
+    matrix.SegmentLength = mMaxQueryLength;
+    matrix.SegmentStride = mNumLanes;
+    matrix.LaneStride    = 0;
+    matrix.Compact       = false;
+    return matrix;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include "Mosaik.h"
+#include "TracebackMatrix.h"
+
+using namespace std;
+
+struct CSimdKernels;
+
+#define MOSAIK_NUM_NUCLEOTIDES 26
+
+// ============================================================================
+// Inter-sequence SIMD fill for the Smith-Waterman-Gotoh local alignment
+//
+// Every vector lane holds a different (reference, query) pair, so a whole
+// batch of short alignments is filled with one pass of the plain row-by-row
+// Gotoh recurrence. The pairs are padded to the longest reference and query
+// of the batch; padded cells never feed a real cell and are excluded from the
+// best cell search. As in the striped kernel the scores are held in 16-bit
+// saturating lanes when the scoring parameters are integral and the best
+// possible score fits, and in single precision lanes otherwise.
+// ============================================================================
+
+class CBatchSmithWaterman {
+public:
+    // constructor
+    CBatchSmithWaterman(const float* pScoringMatrix, float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty);
+    // destructor
+    ~CBatchSmithWaterman(void);
+    // returns true if a SIMD kernel can be used on this CPU
+    static bool IsAvailable(void);
+    // replaces the scoring parameters, the scoring matrix is updated by its owner
+    void SetScores(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty);
+    // returns true if the gap penalties can be handled by the batch kernels
+    bool IsSupported(void) const;
+    // returns the maximum number of pairs that a single fill can hold
+    static unsigned int GetMaxBatchSize(void);
+    // fills the packed traceback matrices of up to GetMaxBatchSize() pairs and locates their best cells. Returns the number of pairs filled.
+    unsigned int Fill(const string** references, const string** queries, const unsigned int numPairs, float* bestScores, unsigned int* bestRows, unsigned int* bestColumns);
+    // returns a view of the packed traceback matrix of the given pair of the last fill
+    CPackedTracebackMatrix GetTracebackMatrix(const unsigned int pair) const;
+private:
+    // the fill kernels picked for this CPU
+    const CSimdKernels* mpKernels;
+    // define scoring constants
+    const float* mpScoringMatrix;
+    float mMatchScore;
+    float mMismatchScore;
+    float mGapOpenPenalty;
+    float mGapExtendPenalty;
+    // keep track of maximum initialized sizes
+    unsigned int mCurrentWorkspaceSize;
+    unsigned int mCurrentTracebackSize;
+    // aligned storage for the row profile and the score vectors
+    char* mWorkspace;
+    // packed traceback cells, interleaved by lane
+    char* mTraceback;
+    // geometry of the last fill
+    unsigned int mMaxQueryLength;
+    unsigned int mNumLanes;
+};
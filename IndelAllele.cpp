@@ -54,9 +54,79 @@ bool operator!=(const IndelAllele& a, const IndelAllele& b) {
     return !(a==b);
 }
 
+// compares the sequences as string::compare does
+static int compareSequences(const char* a, size_t aLength, const char* b, size_t bLength) {
+    int c = memcmp(a, b, min(aLength, bLength));
+    if (c != 0) return c;
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+// orders the alleles field by field rather than by their formatted text
+static bool indelAlleleLess(bool aInsertion, int aPosition, int aLength, const char* aSequence, size_t aSequenceLength,
+                            bool bInsertion, int bPosition, int bLength, const char* bSequence, size_t bSequenceLength) {
+    if (aInsertion != bInsertion) return !aInsertion;
+    if (aPosition != bPosition) return aPosition < bPosition;
+    if (aLength != bLength) return aLength < bLength;
+    return compareSequences(aSequence, aSequenceLength, bSequence, bSequenceLength) < 0;
+}
+
 bool operator<(const IndelAllele& a, const IndelAllele& b) {
-    ostringstream as, bs;
-    as << a;
-    bs << b;
-    return as.str() < bs.str();
+    return indelAlleleLess(a.insertion, a.position, a.length, a.sequence.data(), a.sequence.size(),
+                           b.insertion, b.position, b.length, b.sequence.data(), b.sequence.size());
+}
+
+bool compactIndelAllele(const IndelAllele& indel, CompactIndelAllele& compact) {
+    if (indel.sequence.size() > CompactIndelAllele::MaxSequenceLength) return false;
+    memset(&compact, 0, sizeof(compact));
+    compact.position = indel.position;
+    compact.readPosition = indel.readPosition;
+    compact.length = indel.length;
+    compact.insertion = indel.insertion;
+    compact.sequenceLength = indel.sequence.size();
+    memcpy(compact.sequence, indel.sequence.data(), indel.sequence.size());
+    return true;
+}
+
+IndelAllele expandIndelAllele(const CompactIndelAllele& compact) {
+    return IndelAllele(compact.insertion, compact.length, compact.position, compact.readPosition,
+                       string(compact.sequence, compact.sequenceLength));
+}
+
+ostream& operator<<(ostream& out, const CompactIndelAllele& indel) {
+    out << (indel.insertion ? "i" : "d") << ":" << indel.position << ":" << indel.readPosition << ":" << indel.length << ":";
+    out.write(indel.sequence, indel.sequenceLength);
+    return out;
+}
+
+bool operator==(const CompactIndelAllele& a, const CompactIndelAllele& b) {
+    return (a.insertion == b.insertion
+            && a.length == b.length
+            && a.position == b.position
+            && a.sequenceLength == b.sequenceLength
+            && memcmp(a.sequence, b.sequence, a.sequenceLength) == 0);
+}
+
+bool operator!=(const CompactIndelAllele& a, const CompactIndelAllele& b) {
+    return !(a==b);
+}
+
+bool operator<(const CompactIndelAllele& a, const CompactIndelAllele& b) {
+    return indelAlleleLess(a.insertion, a.position, a.length, a.sequence, a.sequenceLength,
+                           b.insertion, b.position, b.length, b.sequence, b.sequenceLength);
+}
+
+// FNV-1a over the fields, then the sequence
+size_t hashIndelAllele(bool insertion, int length, int position, const char* sequence, size_t sequenceLength) {
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t h = 14695981039346656037ULL;
+    const uint32_t fields[3] = { (uint32_t) insertion, (uint32_t) length, (uint32_t) position };
+    for (int f = 0; f < 3; ++f) {
+        for (int b = 0; b < 4; ++b) {
+            h = (h ^ ((fields[f] >> (8 * b)) & 0xff)) * prime;
+        }
+    }
+    for (size_t i = 0; i < sequenceLength; ++i) {
+        h = (h ^ (unsigned char) sequence[i]) * prime;
+    }
+    return (size_t) h;
 }
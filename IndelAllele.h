@@ -4,6 +4,11 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <stdint.h>
+#include <string.h>
+#if __cplusplus >= 201103L
+#include <functional>
+#endif
 
 using namespace std;
 
@@ -32,6 +37,48 @@ bool homopolymer(string sequence);
 ostream& operator<<(ostream& out, const IndelAllele& indel);
 bool operator==(const IndelAllele& a, const IndelAllele& b);
 bool operator!=(const IndelAllele& a, const IndelAllele& b);
+// orders by kind (deletions first), position, length and sequence, the fields operator== compares
 bool operator<(const IndelAllele& a, const IndelAllele& b);
 
+// an IndelAllele that fits in 32 bytes, with its sequence held inline. Only
+// alleles of up to MaxSequenceLength bases have a compact form. Being plain
+// data, these sort, copy and hash without touching the heap.
+struct CompactIndelAllele {
+    enum { MaxSequenceLength = 18 };
+
+    int32_t position;
+    int32_t readPosition;
+    int32_t length;
+    uint8_t insertion;
+    uint8_t sequenceLength;
+    char    sequence[MaxSequenceLength];
+};
+
+// fills the compact form of the allele, returns false if its sequence is too long for it
+bool compactIndelAllele(const IndelAllele& indel, CompactIndelAllele& compact);
+IndelAllele expandIndelAllele(const CompactIndelAllele& compact);
+
+ostream& operator<<(ostream& out, const CompactIndelAllele& indel);
+bool operator==(const CompactIndelAllele& a, const CompactIndelAllele& b);
+bool operator!=(const CompactIndelAllele& a, const CompactIndelAllele& b);
+bool operator<(const CompactIndelAllele& a, const CompactIndelAllele& b);
+
+// hashes the fields operator== compares, so an allele and its compact form hash alike
+size_t hashIndelAllele(bool insertion, int length, int position, const char* sequence, size_t sequenceLength);
+
+#if __cplusplus >= 201103L
+namespace std {
+    template<> struct hash<IndelAllele> {
+        size_t operator()(const IndelAllele& indel) const {
+            return hashIndelAllele(indel.insertion, indel.length, indel.position, indel.sequence.data(), indel.sequence.size());
+        }
+    };
+    template<> struct hash<CompactIndelAllele> {
+        size_t operator()(const CompactIndelAllele& indel) const {
+            return hashIndelAllele(indel.insertion, indel.length, indel.position, indel.sequence, indel.sequenceLength);
+        }
+    };
+}
+#endif
+
 #endif
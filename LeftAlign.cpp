@@ -1,8 +1,110 @@
 #include "LeftAlign.h"
 
+#include <string.h>
+#include <stdexcept>
+
 //bool debug;
 #define VERBOSE_DEBUG
 
+// The left-aligner reads the sequences in place. Where the string version
+// took a substring or called at(), the view version checks the position the
+// same way and throws out_of_range, so failed realignments fail as before.
+
+static inline void checkPosition(size_t position, size_t length) {
+    if (position > length) throw out_of_range("leftAlign: position beyond the end of the sequence");
+}
+
+static inline char baseAt(const char* sequence, size_t length, size_t position) {
+    if (position >= length) throw out_of_range("leftAlign: position beyond the end of the sequence");
+    return sequence[position];
+}
+
+// the length of sequence.substr(position, length)
+static inline size_t substringLength(size_t sequenceLength, size_t position, size_t length) {
+    checkPosition(position, sequenceLength);
+    return min(length, sequenceLength - position);
+}
+
+// seq == sequence.substr(position, length)
+static inline bool equalsSubstring(const string& seq, const char* sequence, size_t sequenceLength, size_t position, size_t length) {
+    const size_t n = substringLength(sequenceLength, position, length);
+    return seq.size() == n && memcmp(seq.data(), sequence + position, n) == 0;
+}
+
+// homopolymer(string) on a view. The empty sequence is not a homopolymer.
+static inline bool isHomopolymer(const char* sequence, size_t length) {
+    if (length == 0) return false;
+    for (size_t i = 1; i < length; ++i) {
+        if (sequence[i] != sequence[0]) return false;
+    }
+    return true;
+}
+
+// string::rfind of needle in the first length bases of sequence
+static size_t reverseFind(const char* sequence, size_t length, const char* needle, size_t needleLength) {
+    if (needleLength > length) return string::npos;
+    for (size_t p = length - needleLength; ; --p) {
+        if (memcmp(sequence + p, needle, needleLength) == 0) return p;
+        if (p == 0) return string::npos;
+    }
+}
+
+// string::find of needle in sequence, starting at position
+static size_t forwardFind(const char* sequence, size_t length, const char* needle, size_t needleLength, size_t position) {
+    if (position > length || needleLength > length - position) return string::npos;
+    for (size_t p = position; p + needleLength <= length; ++p) {
+        if (memcmp(sequence + p, needle, needleLength) == 0) return p;
+    }
+    return string::npos;
+}
+
+// adds an indel to the workspace, reusing the sequence buffer of an earlier call
+static IndelAllele& addIndel(vector<IndelAllele>& indels, unsigned int& numIndels, bool insertion, unsigned int length, int position, int readPosition,
+                             const char* sequence, size_t sequenceLength, size_t sequencePosition) {
+    const size_t n = substringLength(sequenceLength, sequencePosition, length);
+    if (numIndels == indels.size()) indels.push_back(IndelAllele(insertion, 0, 0, 0, string()));
+    IndelAllele& indel = indels[numIndels++];
+    indel.insertion = insertion;
+    indel.length = length;
+    indel.position = position;
+    indel.readPosition = readPosition;
+    indel.sequence.assign(sequence + sequencePosition, n);
+    return indel;
+}
+
+// a.assign(sequence.substr(position, length))
+static inline void assignSubstring(string& a, const char* sequence, size_t sequenceLength, size_t position, size_t length) {
+    a.assign(sequence + position, substringLength(sequenceLength, position, length));
+}
+
+// a.append(sequence.substr(position, length))
+static inline void appendSubstring(string& a, const char* sequence, size_t sequenceLength, size_t position, size_t length) {
+    a.append(sequence + position, substringLength(sequenceLength, position, length));
+}
+
+// reports an indel whose sequence does not match the alignment
+static void reportInconsistentIndel(const IndelAllele& indel, const char* expected, size_t expectedLength,
+                                    const char* baseReference, size_t baseReferenceLength, const char* query, size_t queryLength) {
+    cerr << "failure: " << indel << " should be ";
+    cerr.write(expected, expectedLength) << endl;
+    cerr.write(baseReference, baseReferenceLength) << endl;
+    cerr.write(query, queryLength) << endl;
+    throw 1;
+}
+
+static bool isEmptyCigarOperation(uint32_t packed) {
+    return cigarLength(packed) == 0;
+}
+
+// replaces the cigar with the rebuilt one, leaving out its empty operations.
+// Returns true if the cigar changed.
+static bool replaceCigar(vector<uint32_t>& cigar, vector<uint32_t>& newCigar) {
+    newCigar.erase(remove_if(newCigar.begin(), newCigar.end(), isEmptyCigarOperation), newCigar.end());
+    if (newCigar == cigar) return false;
+    cigar.swap(newCigar);
+    return true;
+}
+
 // Attempts to left-realign all the indels represented by the alignment cigar.
 //
 // This is done by shifting all indels as far left as they can go without
@@ -22,86 +124,69 @@
 // element.
 //
 // In practice, we must call this function until the alignment is stabilized.
+// It is deprecated: normalizeIndels reaches that alignment in one sweep.
 //
-bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequence, int& offset, bool debug) {
-
-    debug = false;
-
-    string referenceSequence = baseReferenceSequence.substr(offset);
+// The sequences are views of the caller's buffers and the packed cigar is
+// rewritten in place. The indels and the rebuilt cigar live in the workspace,
+// so once it has grown to the size of the alignment nothing is allocated.
+//
+bool leftAlign(const char* querySequence, size_t queryLength, vector<uint32_t>& cigar,
+               const char* baseReferenceSequence, size_t baseReferenceLength, int& offset, LeftAlignWorkspace& workspace) {
 
-    int arsOffset = 0; // pointer to insertion point in aligned reference sequence
-    string alignedReferenceSequence, alignedQuerySequence;
-    if (debug) alignedReferenceSequence = referenceSequence;
-    if (debug) alignedQuerySequence = querySequence;
-    int aabOffset = 0;
+    checkPosition(offset, baseReferenceLength);
+    const char* referenceSequence = baseReferenceSequence + offset;
+    size_t referenceLength = baseReferenceLength - offset;
 
     // store information about the indels
-    vector<IndelAllele> indels;
+    vector<IndelAllele>& indels = workspace.indels;
+    unsigned int numIndels = 0;
 
     int rp = 0;  // read position, 0-based relative to read
     int sp = 0;  // sequence position
 
-    string softBegin;
-    string softEnd;
+    // only the lengths of the soft clips are used
+    size_t softBegin = 0;
+    size_t softEnd = 0;
 
-    string cigarbefore = cigar;
-
-    vector<pair<int, string> > cigarData = splitCIGAR(cigar);
-    for (vector<pair<int, string> >::const_iterator c = cigarData.begin();
-        c != cigarData.end(); ++c) {
-        unsigned int l = c->first;
-        string t = c->second;
-	if (debug) cerr << l << t << " " << sp << " " << rp << endl;
-        if (t == "M") { // match or mismatch
+    for (vector<uint32_t>::const_iterator c = cigar.begin();
+        c != cigar.end(); ++c) {
+        unsigned int l = cigarLength(*c);
+        int t = cigarOperation(*c);
+        if (t == CIGAR_M) { // match or mismatch
             sp += l;
             rp += l;
-        } else if (t == "D") { // deletion
-            indels.push_back(IndelAllele(false, l, sp, rp, referenceSequence.substr(sp, l)));
-            if (debug) { cerr << indels.back() << endl;  alignedQuerySequence.insert(rp + aabOffset, string(l, '-')); }
-            aabOffset += l;
+        } else if (t == CIGAR_D) { // deletion
+            addIndel(indels, numIndels, false, l, sp, rp, referenceSequence, referenceLength, sp);
             sp += l;  // update reference sequence position
-        } else if (t == "I") { // insertion
-            indels.push_back(IndelAllele(true, l, sp, rp, querySequence.substr(rp, l)));
-            if (debug) { cerr << indels.back() << endl; alignedReferenceSequence.insert(sp + softBegin.size() + arsOffset, string(l, '-')); }
-            arsOffset += l;
+        } else if (t == CIGAR_I) { // insertion
+            addIndel(indels, numIndels, true, l, sp, rp, querySequence, queryLength, rp);
             rp += l;
-        } else if (t == "S") { // soft clip, clipped sequence present in the read not matching the reference
+        } else if (t == CIGAR_S) { // soft clip, clipped sequence present in the read not matching the reference
             // remove these bases from the refseq and read seq, but don't modify the alignment sequence
             if (rp == 0) {
-                alignedReferenceSequence = string(l, '*') + alignedReferenceSequence;
-		//indels.push_back(IndelAllele(true, l, sp, rp, querySequence.substr(rp, l)));
-                softBegin = querySequence.substr(0, l);
+                softBegin = min((size_t) l, queryLength);
             } else {
-                alignedReferenceSequence = alignedReferenceSequence + string(l, '*');
-		//indels.push_back(IndelAllele(true, l, sp, rp, querySequence.substr(rp, l)));
-                softEnd = querySequence.substr(querySequence.size() - l, l);
+                softEnd = substringLength(queryLength, queryLength - l, l);
             }
             rp += l;
-        } else if (t == "H") { // hard clip on the read, clipped sequence is not present in the read
-        } else if (t == "N") { // skipped region in the reference not present in read, aka splice
+        } else if (t == CIGAR_H) { // hard clip on the read, clipped sequence is not present in the read
+        } else if (t == CIGAR_N) { // skipped region in the reference not present in read, aka splice
             sp += l;
         }
     }
 
-
-    if (debug) cerr << "| " << cigarbefore << endl
-		    << "| " << alignedReferenceSequence << endl
-		    << "| " << alignedQuerySequence << endl;
-
     // if no indels, return the alignment
-    if (indels.empty()) { return false; }
+    if (numIndels == 0) { return false; }
 
-    if (debug) {
-	for (vector<IndelAllele>::iterator a = indels.begin(); a != indels.end(); ++a) cerr << *a << " ";
-	cerr << endl;
-    }
+    const vector<IndelAllele>::iterator begin = indels.begin();
+    const vector<IndelAllele>::iterator end = indels.begin() + numIndels;
 
     // for each indel, from left to right
     //     while the indel sequence repeated to the left and we're not matched up with the left-previous indel
     //         move the indel left
 
-    vector<IndelAllele>::iterator previous = indels.begin();
-    for (vector<IndelAllele>::iterator id = indels.begin(); id != indels.end(); ++id) {
+    vector<IndelAllele>::iterator previous = begin;
+    for (vector<IndelAllele>::iterator id = begin; id != end; ++id) {
 
         // left shift by repeats
         //
@@ -121,21 +206,12 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
             int steppos = indel.position - i;
             int readsteppos = indel.readPosition - i;
 
-            if (debug) {
-                if (steppos >= 0 && readsteppos >= 0) {
-                    cerr << "refseq flank " << referenceSequence.substr(steppos, indel.length) << endl;
-                    cerr << "qryseq flank " << querySequence.substr(readsteppos, indel.length) << endl;
-                    cerr << "indelseq     " << indel.sequence << endl;
-                }
-            }
-
             while (steppos >= 0 && readsteppos >= 0
-                   && indel.sequence == referenceSequence.substr(steppos, indel.length)
-                   && indel.sequence == querySequence.substr(readsteppos, indel.length)
-                   && (id == indels.begin()
+                   && equalsSubstring(indel.sequence, referenceSequence, referenceLength, steppos, indel.length)
+                   && equalsSubstring(indel.sequence, querySequence, queryLength, readsteppos, indel.length)
+                   && (id == begin
                        || (previous->insertion && steppos >= previous->position)
                        || (!previous->insertion && steppos >= previous->position + previous->length))) {
-                LEFTALIGN_DEBUG((indel.insertion ? "insertion " : "deletion ") << indel << " shifting " << i << "bp left" << endl);
                 indel.position -= i;
                 indel.readPosition -= i;
                 steppos = indel.position - i;
@@ -166,41 +242,30 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
         steppos = indel.position - 1;
         readsteppos = indel.readPosition - 1;
         while (steppos >= 0 && readsteppos >= 0
-               && querySequence.at(readsteppos) == referenceSequence.at(steppos)
-	       && referenceSequence.size() > steppos + indel.length
-	       && indel.sequence.at((int) indel.sequence.size() - 1) == referenceSequence.at(steppos + indel.length) // are the exchanged bases going to match wrt. the reference?
-               && querySequence.at(readsteppos) == indel.sequence.at((int) indel.sequence.size() - 1)
-               && (id == indels.begin()
+               && baseAt(querySequence, queryLength, readsteppos) == baseAt(referenceSequence, referenceLength, steppos)
+               && referenceLength > steppos + indel.length
+               && baseAt(indel.sequence.data(), indel.sequence.size(), (int) indel.sequence.size() - 1) == baseAt(referenceSequence, referenceLength, steppos + indel.length) // are the exchanged bases going to match wrt. the reference?
+               && baseAt(querySequence, queryLength, readsteppos) == baseAt(indel.sequence.data(), indel.sequence.size(), (int) indel.sequence.size() - 1)
+               && (id == begin
                    || (previous->insertion && indel.position - 1 >= previous->position)
                    || (!previous->insertion && indel.position - 1 >= previous->position + previous->length))) {
-            if (debug) cerr << (indel.insertion ? "insertion " : "deletion ") << indel << " exchanging bases " << 1 << "bp left" << endl;
-            indel.sequence = indel.sequence.at(indel.sequence.size() - 1) + indel.sequence.substr(0, indel.sequence.size() - 1);
+            rotate(indel.sequence.begin(), indel.sequence.end() - 1, indel.sequence.end());
             indel.position -= 1;
             indel.readPosition -= 1;
-	    if (debug) cerr << indel << endl;
             steppos = indel.position - 1;
             readsteppos = indel.readPosition - 1;
-	    //if (debug && steppos && readsteppos) cerr << querySequence.at(readsteppos) << " ==? " << referenceSequence.at(steppos) << endl;
-	    //if (debug && steppos && readsteppos) cerr << indel.sequence.at((int) indel.sequence.size() - 1) << " ==? " << referenceSequence.at(steppos + indel.length) << endl;
         }
         // tracks previous indel, so we don't run into it with the next shift
         previous = id;
     }
 
-    if (debug) {
-	for (vector<IndelAllele>::iterator a = indels.begin(); a != indels.end(); ++a) cerr << *a << " ";
-	cerr << endl;
-    }
-
-    if (debug) cerr << "bring together floating indels" << endl;
-
     // bring together floating indels
     // from left to right
     // check if we could merge with the next indel
     // if so, adjust so that we will merge in the next step
-    if (indels.size() > 1) {
-        previous = indels.begin();
-        for (vector<IndelAllele>::iterator id = (indels.begin() + 1); id != indels.end(); ++id) {
+    if (numIndels > 1) {
+        previous = begin;
+        for (vector<IndelAllele>::iterator id = (begin + 1); id != end; ++id) {
             IndelAllele& indel = *id;
             // parsimony: could we shift right and merge with the previous indel?
             // if so, do it
@@ -215,76 +280,23 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
                         && (previous->position + previous->length < indel.position)
                         && (previous->readPosition < indel.readPosition)
                         ))) {
-                if (previous->homopolymer()) {
-                    string seq = referenceSequence.substr(prev_end_ref, indel.position - prev_end_ref);
-                    string readseq = querySequence.substr(prev_end_read, indel.position - prev_end_ref);
-                    if (debug) cerr << "seq: " << seq << endl << "readseq: " << readseq << endl;
-                    if (previous->sequence.at(0) == seq.at(0)
-                            && homopolymer(seq)
-                            && homopolymer(readseq)) {
-                        if (debug) cerr << "moving " << *previous << " right to " 
-					<< (indel.insertion ? indel.position : indel.position - previous->length) << endl;
+                if (isHomopolymer(previous->sequence.data(), previous->sequence.size())) {
+                    const size_t seqLength = substringLength(referenceLength, prev_end_ref, indel.position - prev_end_ref);
+                    const size_t readseqLength = substringLength(queryLength, prev_end_read, indel.position - prev_end_ref);
+                    const char* seq = referenceSequence + prev_end_ref;
+                    const char* readseq = querySequence + prev_end_read;
+                    if (baseAt(previous->sequence.data(), previous->sequence.size(), 0) == baseAt(seq, seqLength, 0)
+                            && isHomopolymer(seq, seqLength)
+                            && isHomopolymer(readseq, readseqLength)) {
                         previous->position = indel.insertion ? indel.position : indel.position - previous->length;
 			previous->readPosition = !indel.insertion ? indel.readPosition : indel.readPosition - previous->readLength(); // should this be readLength?
                     }
                 }
-		/*
-                else {
-                    int pos = previous->position;
-		    int readpos = previous->readPosition;
-                    while (pos < (int) referenceSequence.length() &&
-                            ((previous->insertion && pos + previous->length <= indel.position)
-                            ||
-                            (!previous->insertion && pos + previous->length < indel.position))
-			   && previous->sequence == referenceSequence.substr(pos + previous->length, previous->length)
-			   && previous->sequence == querySequence.substr(readpos + previous->length, previous->length)
-			) {
-                        pos += previous->length;
-			readpos += previous->length;
-                    }
-		    string seq = previous->sequence;
-                    if (pos > previous->position) {
-			// wobble bases right to left as far as we can go
-			int steppos = previous->position + seq.size();
-			int readsteppos = previous->readPosition + seq.size();
-
-			while (querySequence.at(readsteppos) == referenceSequence.at(steppos)
-			       && querySequence.at(readsteppos) == seq.at(0)
-			       && (id == indels.begin()
-				   || (indel.insertion && pos + seq.size() - 1 <= indel.position)
-				   || (!previous->insertion && indel.position - 1 >= pos + previous->length))) {
-			    seq = seq.substr(1) + seq.at(0);
-			    ++pos;
-			    ++readpos;
-			    steppos = pos + 1;
-			    readsteppos = readpos + 1;
-			}
-
-			if (((previous->insertion && pos + previous->length == indel.position)
-			     ||
-			     (!previous->insertion && pos == indel.position - previous->length))
-			    ) {
-			    if (debug) cerr << "right-merging tandem repeat: moving " << *previous << " right to " << pos << endl;
-			    previous->position = pos;
-			    previous->readPosition = readpos;
-			    previous->sequence = seq;
-			}
-                    }
-                }
-		*/
             }
             previous = id;
         }
     }
 
-    if (debug) {
-	for (vector<IndelAllele>::iterator a = indels.begin(); a != indels.end(); ++a) cerr << *a << " ";
-	cerr << endl;
-    }
-
-
-    if (debug) cerr << "bring in indels at ends of read" << endl;
-
     // try to "bring in" repeat indels at the end, for maximum parsimony
     //
     // e.g.
@@ -299,52 +311,38 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
     //
     // here we take the parsimonious explanation
 
-    if (!indels.empty()) {
+    {
 	// deal with the first indel
 	// the first deletion ... or the biggest deletion
-	vector<IndelAllele>::iterator a = indels.begin();
-	vector<IndelAllele>::iterator del = indels.begin();
-	for (; a != indels.end(); ++a) {
-	    //if (!a->insertion && a->length > biggestDel->length) biggestDel = a;
+	vector<IndelAllele>::iterator a = begin;
+	vector<IndelAllele>::iterator del = begin;
+	for (; a != end; ++a) {
 	    if (!a->insertion && a->length) del = a;
 	if (!del->insertion) {
-	    //if (!indel.insertion) { // only handle deletions like this for now
-	    //if (!indel.insertion && !(indels.size() > 1 && indel.readPosition == indels.at(1).readPosition)) { // only handle deletions like this for now
 	    int insertedBpBefore = 0;
 	    int deletedBpBefore = 0;
-	    for (vector<IndelAllele>::iterator i = indels.begin(); i != del; ++i) {
+	    for (vector<IndelAllele>::iterator i = begin; i != del; ++i) {
 		if (i->insertion) insertedBpBefore += i->length;
 		else deletedBpBefore += i->length;
 	    }
 	    IndelAllele& indel = *del;
 	    int minsize = indel.length;
 	    int flankingLength = indel.readPosition;
-	    if (debug) cerr << indel << endl;
-	    string flanking = querySequence.substr(0, flankingLength);
-	    if (debug) cerr << flanking << endl;
+	    const size_t flankingSize = min((size_t) flankingLength, queryLength);
 
-	    size_t p = referenceSequence.substr(0, indel.position + indel.length).rfind(flanking);
-	    if (p == string::npos) {
-		if (debug) cerr << "flanking not found" << endl;
-	    } else {
-		if (debug) {
-		    cerr << "flanking is at " << p << endl;
-		    cerr << "minsize would be " << (indel.position + indel.length) - ((int) p + flankingLength) << endl;
-		}
+	    size_t p = reverseFind(referenceSequence, min((size_t) (indel.position + indel.length), referenceLength), querySequence, flankingSize);
+	    if (p != string::npos) {
 		minsize = (indel.position + indel.length) - ((int) p + flankingLength);
 	    }
 
-	    if (debug) cerr << minsize << endl;
-
 	    if (minsize >= 0 && minsize < indel.length) {
 
-		int softdiff = softBegin.size();
-		if (!softBegin.empty()) { // remove soft clips if we can
-		    if (flankingLength < softBegin.size()) {
-			softBegin = softBegin.substr(0, flankingLength - softBegin.size());
-			softdiff -= softBegin.size();
+		int softdiff = softBegin;
+		if (softBegin) { // remove soft clips if we can
+		    if (flankingLength < softBegin) {
+			softdiff = 0; // the soft clip is kept
 		    } else {
-			softBegin.clear();
+			softBegin = 0;
 		    }
 		}
 
@@ -353,17 +351,18 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 		// the positional offset of the reference sequence == the new position of the deletion - the flanking length
 
 		int diff = indel.length - minsize - softdiff  + deletedBpBefore - insertedBpBefore;
-		//int querydiff = indel.length - minsize - softBegin.size() - insertedBpBefore + deletedBpBefore;
-		if (debug) cerr << "adjusting " << indel.length <<" " << minsize << "  " << softdiff << " " << diff << endl;
 		offset += diff;
 		///
 		indel.length = minsize;
-		indel.sequence = indel.sequence.substr(indel.sequence.size() - minsize);
+		checkPosition(indel.sequence.size() - minsize, indel.sequence.size());
+		indel.sequence.erase(0, indel.sequence.size() - minsize);
 		indel.position = flankingLength;
 		indel.readPosition = indel.position; // if we have removed all the sequence before, this should be ==
-		referenceSequence = referenceSequence.substr(diff);
+		checkPosition(diff, referenceLength);
+		referenceSequence += diff;
+		referenceLength -= diff;
 
-		for (vector<IndelAllele>::iterator i = indels.begin(); i != indels.end(); ++i) {
+		for (vector<IndelAllele>::iterator i = begin; i != end; ++i) {
 		    if (i < del) {
 			i->length = 0; // remove
 		    } else if (i > del) {
@@ -371,42 +370,30 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 		    }
 		}
 	    }
-	    if (debug) cerr << indel << endl;
 
 	    // now, do the same for the reverse
 	    if (indel.length > 0) {
 		int minsize = indel.length + 1;
-		int flankingLength = querySequence.size() - indel.readPosition + indel.readLength();
-		string flanking = querySequence.substr(indel.readPosition + indel.readLength(), flankingLength);
-		int indelRefEnd = indel.position + indel.referenceLength();
-
-		size_t p = referenceSequence.find(flanking, indel.position);
-		if (p == string::npos) {
-		    if (debug)
-			cerr << "flanking not found" << endl;
-		} else {
-		    if (debug) {
-			cerr << "flanking is at " << p << endl;
-			cerr << "minsize would be " << (int) p - indel.position << endl;
-		    }
+		int flankingLength = queryLength - indel.readPosition + indel.readLength();
+		const size_t flankingPosition = indel.readPosition + indel.readLength();
+		const size_t flankingSize = substringLength(queryLength, flankingPosition, flankingLength);
+
+		size_t p = forwardFind(referenceSequence, referenceLength, querySequence + flankingPosition, flankingSize, indel.position);
+		if (p != string::npos) {
 		    minsize = (int) p - indel.position;
 		}
 
-		if (debug) cerr << "minsize " << minsize << endl;
 		if (minsize >= 0 && minsize <= indel.length) {
-		    //referenceSequence = referenceSequence.substr(0, referenceSequence.size() - (indel.length - minsize));
-		    if (debug) cerr << "adjusting " << indel << endl;
 		    indel.length = minsize;
-		    indel.sequence = indel.sequence.substr(0, minsize);
-		    //cerr << indel << endl;
-		    if (!softEnd.empty()) { // remove soft clips if we can
-			if (flankingLength < softEnd.size()) {
-			    softEnd = softEnd.substr(flankingLength - softEnd.size());
+		    indel.sequence.resize(min((size_t) minsize, indel.sequence.size()));
+		    if (softEnd) { // remove soft clips if we can
+			if (flankingLength < softEnd) {
+			    checkPosition(flankingLength - softEnd, softEnd);
 			} else {
-			    softEnd.clear();
+			    softEnd = 0;
 			}
 		    }
-		    for (vector<IndelAllele>::iterator i = indels.begin(); i != indels.end(); ++i) {
+		    for (vector<IndelAllele>::iterator i = begin; i != end; ++i) {
 			if (i > del) {
 			    i->length = 0; // remove
 			}
@@ -417,74 +404,39 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 	}
     }
 
-    if (debug) {
-	for (vector<IndelAllele>::iterator a = indels.begin(); a != indels.end(); ++a) cerr << *a << " ";
-	cerr << endl;
-    }
-
-    if (debug) cerr << "parsing indels" << endl;
-
     // if soft clipping can be reduced by adjusting the tailing indels in the read, do it
     // TODO
 
-    /*
-    int numEmptyIndels = 0;
-
-    if (!indels.empty()) {
-	vector<IndelAllele>::iterator a = indels.begin();
-	while (a != indels.end()) {
-	    if (debug) cerr << "parsing " << *a << endl;
-	    if (!(a->length > 0 && a->position >= 0)) {
-		++numEmptyIndels;
-	    }
-	    ++a;
-	}
-    }
-    */
-
-    for (vector<IndelAllele>::iterator i = indels.begin(); i != indels.end(); ++i) {
+    for (vector<IndelAllele>::iterator i = begin; i != end; ++i) {
 	if (i->length == 0) continue;
 	if (i->insertion) {
-	    if (querySequence.substr(i->readPosition, i->readLength()) != i->sequence) {
-		cerr << "failure: " << *i << " should be " << querySequence.substr(i->readPosition, i->readLength()) << endl;
-		cerr << baseReferenceSequence << endl;
-		cerr << querySequence << endl;
-		throw 1;
+	    const size_t n = substringLength(queryLength, i->readPosition, i->readLength());
+	    if (i->sequence.size() != n || memcmp(i->sequence.data(), querySequence + i->readPosition, n) != 0) {
+		reportInconsistentIndel(*i, querySequence + i->readPosition, n, baseReferenceSequence, baseReferenceLength, querySequence, queryLength);
 	    }
 	} else {
-	    if (referenceSequence.substr(i->position, i->length) != i->sequence) {
-		cerr << "failure: " << *i << " should be " << referenceSequence.substr(i->position, i->length) << endl;
-		cerr << baseReferenceSequence << endl;
-		cerr << querySequence << endl;
-		throw 1;
+	    const size_t n = substringLength(referenceLength, i->position, i->length);
+	    if (i->sequence.size() != n || memcmp(i->sequence.data(), referenceSequence + i->position, n) != 0) {
+		reportInconsistentIndel(*i, referenceSequence + i->position, n, baseReferenceSequence, baseReferenceLength, querySequence, queryLength);
 	    }
 	}
     }
 
-    if (indels.size() > 1) {
-        vector<IndelAllele>::iterator id = indels.begin();
-	while ((id + 1) != indels.end()) {
-	    if (debug) {
-		cerr << "indels: ";
-		for (vector<IndelAllele>::iterator a = indels.begin(); a != indels.end(); ++a) cerr << *a << " ";
-		cerr << endl;
-		//for (vector<IndelAllele>::iterator a = newIndels.begin(); a != newIndels.end(); ++a) cerr << *a << " ";
-		//cerr << endl;
-	    }
+    if (numIndels > 1) {
+        vector<IndelAllele>::iterator id = begin;
+	while ((id + 1) != end) {
 
 	    // get the indels to try to merge
-	    while (id->length == 0 && (id + 1) != indels.end()) ++id;
+	    while (id->length == 0 && (id + 1) != end) ++id;
 	    vector<IndelAllele>::iterator idn = (id + 1);
-	    while (idn != indels.end() && idn->length == 0) ++idn;
-	    if (idn == indels.end()) break;
+	    while (idn != end && idn->length == 0) ++idn;
+	    if (idn == end) break;
 
             IndelAllele& indel = *idn;
 	    IndelAllele& last = *id;
-	    if (debug) cerr << "trying " << last << " against " << indel << endl;
 
 	    int lastend = last.insertion ? last.position : (last.position + last.length);
 	    if (indel.position == lastend) {
-		if (debug) cerr << "indel.position " << indel.position << " lastend " << lastend << endl;
 		if (indel.insertion == last.insertion) {
 		    last.length += indel.length;
 		    last.sequence += indel.sequence;
@@ -492,21 +444,19 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 		    indel.sequence.clear();
 		    id = idn;
 		} else if (last.length && indel.length) { // if the end of the previous == the start of the current, cut it off of both the ins and the del
-		    if (debug) cerr << "Merging " << last << " " << indel << endl;
 		    int matchsize = 1;
 		    int biggestmatchsize = 0;
 
 		    while (matchsize <= last.sequence.size() && matchsize <= indel.sequence.size()) {
-			if (last.sequence.substr(last.sequence.size() - matchsize) == indel.sequence.substr(0, matchsize)) {
+			if (memcmp(last.sequence.data() + last.sequence.size() - matchsize, indel.sequence.data(), matchsize) == 0) {
 			    biggestmatchsize = matchsize;
 			}
 			++matchsize;
 		    }
-		    if (debug) cerr << "biggestmatchsize " << biggestmatchsize << endl;
 
-		    last.sequence = last.sequence.substr(0, last.sequence.size() - biggestmatchsize);
+		    last.sequence.resize(last.sequence.size() - biggestmatchsize);
 		    last.length -= biggestmatchsize;
-		    indel.sequence = indel.sequence.substr(biggestmatchsize);
+		    indel.sequence.erase(0, biggestmatchsize);
 		    indel.length -= biggestmatchsize;
 		    if (indel.insertion) indel.readPosition += biggestmatchsize;
 		    else indel.position += biggestmatchsize;
@@ -517,110 +467,76 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 		}
 	    } else {
 		if (last.insertion != indel.insertion) {
-		    if (debug) cerr << "merging by overlap " << last << " " << indel << endl;
 		    // see if we can slide the sequence in between these two indels together
-		    string lastOverlapSeq;
-		    string indelOverlapSeq;
+		    string& lastOverlapSeq = workspace.lastOverlap;
+		    string& indelOverlapSeq = workspace.indelOverlap;
 
 		    if (last.insertion) {
-			lastOverlapSeq =
-			    last.sequence
-			    + querySequence.substr(last.readPosition + last.readLength(),
-						   indel.readPosition - (last.readPosition + last.readLength()));
-			indelOverlapSeq =
-			    referenceSequence.substr(last.position + last.referenceLength(),
-						     indel.position - (last.position + last.referenceLength()))
-			    + indel.sequence;
+			lastOverlapSeq = last.sequence;
+			appendSubstring(lastOverlapSeq, querySequence, queryLength, last.readPosition + last.readLength(),
+					indel.readPosition - (last.readPosition + last.readLength()));
+			assignSubstring(indelOverlapSeq, referenceSequence, referenceLength, last.position + last.referenceLength(),
+					indel.position - (last.position + last.referenceLength()));
+			indelOverlapSeq += indel.sequence;
 		    } else {
-			lastOverlapSeq =
-			    last.sequence
-			    + referenceSequence.substr(last.position + last.referenceLength(),
-						       indel.position - (last.position + last.referenceLength()));
-			indelOverlapSeq =
-			    querySequence.substr(last.readPosition + last.readLength(),
-						 indel.readPosition - (last.readPosition + last.readLength()))
-			    + indel.sequence;
-		    }
-
-		    if (debug) {
-			if (!last.insertion) {
-			    if (last.insertion) cerr << string(last.length, '-');
-			    cerr << lastOverlapSeq;
-			    if (indel.insertion) cerr << string(indel.length, '-');
-			    cerr << endl;
-			    if (!last.insertion) cerr << string(last.length, '-');
-			    cerr << indelOverlapSeq;
-			    if (!indel.insertion) cerr << string(indel.length, '-');
-			    cerr << endl;
-			} else {
-			    if (last.insertion) cerr << string(last.length, '-');
-			    cerr << indelOverlapSeq;
-			    if (indel.insertion) cerr << string(indel.length, '-');
-			    cerr << endl;
-			    if (!last.insertion) cerr << string(last.length, '-');
-			    cerr << lastOverlapSeq;
-			    if (!indel.insertion) cerr << string(indel.length, '-');
-			    cerr << endl;
-			}
+			lastOverlapSeq = last.sequence;
+			appendSubstring(lastOverlapSeq, referenceSequence, referenceLength, last.position + last.referenceLength(),
+					indel.position - (last.position + last.referenceLength()));
+			assignSubstring(indelOverlapSeq, querySequence, queryLength, last.readPosition + last.readLength(),
+					indel.readPosition - (last.readPosition + last.readLength()));
+			indelOverlapSeq += indel.sequence;
 		    }
 
-
 		    int dist = min(last.length, indel.length);
 		    int matchingInBetween = indel.position - (last.position + last.referenceLength());
 		    int previousMatchingInBetween = matchingInBetween;
-		    //int matchingInBetween = indel.position - last.position;
-		    if (debug) cerr << "matchingInBetween " << matchingInBetween << endl;
-		    if (debug) cerr << "dist " << dist << endl;
-		    int mindist = matchingInBetween - dist;
 		    if (lastOverlapSeq == indelOverlapSeq) {
 			matchingInBetween = lastOverlapSeq.size();
 		    } else {
-			// TODO change to use string::find()
 			for (int i = dist; i > 0; --i) {
-			    if (debug) cerr << "lastoverlap: "
-					    << lastOverlapSeq.substr(lastOverlapSeq.size() - previousMatchingInBetween - i)
-					    << " thisoverlap: "
-					    << indelOverlapSeq.substr(0, i + previousMatchingInBetween) << endl;
-			    if (lastOverlapSeq.substr(lastOverlapSeq.size() - previousMatchingInBetween - i)
-				== indelOverlapSeq.substr(0, i + previousMatchingInBetween)) {
+			    // the suffix of lastOverlapSeq against the prefix of indelOverlapSeq
+			    const size_t suffixPosition = lastOverlapSeq.size() - previousMatchingInBetween - i;
+			    checkPosition(suffixPosition, lastOverlapSeq.size());
+			    const size_t suffixLength = lastOverlapSeq.size() - suffixPosition;
+			    const size_t prefixLength = min((size_t) (i + previousMatchingInBetween), indelOverlapSeq.size());
+			    if (suffixLength == prefixLength
+				&& memcmp(lastOverlapSeq.data() + suffixPosition, indelOverlapSeq.data(), suffixLength) == 0) {
 				matchingInBetween = previousMatchingInBetween + i;
 				break;
 			    }
 			}
 		    }
-		    //cerr << last << " " << indel << endl;
 		    if (matchingInBetween > 0 && matchingInBetween > previousMatchingInBetween) {
-			if (debug) cerr << "matching " << matchingInBetween  << "bp between " << last << " " << indel
-				        << " was matching " << previousMatchingInBetween << endl;
 			int diff = matchingInBetween - previousMatchingInBetween;
 			last.length -= diff;
-			last.sequence = last.sequence.substr(0, last.length);
+			last.sequence.resize(min((size_t) last.length, last.sequence.size()));
 			indel.length -= diff;
-			indel.sequence = indel.sequence.substr(diff);
+			checkPosition(diff, indel.sequence.size());
+			indel.sequence.erase(0, diff);
 			if (!indel.insertion) indel.position += diff;
 			else indel.readPosition += diff;
-			if (debug) cerr << last << " " << indel << endl;
-		    }// else if (matchingInBetween == 0 || matchingInBetween == indel.position - last.position) {
-			//if (!newIndels.empty()) newIndels.pop_back();
-		    //} //else { newIndels.push_back(indel); }
+		    }
 		    id = idn;
-		    //newIndels.push_back(indel);
 		} else {
 		    id = idn;
-		    //newIndels.push_back(indel);
 		}
 	    }
 	}
     }
 
-    vector<IndelAllele> newIndels;
-    for (vector<IndelAllele>::iterator i = indels.begin(); i != indels.end(); ++i) {
+    // remove dels at front, keeping the remaining indels in order
+    unsigned int numNewIndels = 0;
+    for (vector<IndelAllele>::iterator i = begin; i != end; ++i) {
 	if (!i->insertion && i->position == 0) { offset += i->length;
-	} else if (i->length > 0) newIndels.push_back(*i); // remove dels at front
+	} else if (i->length > 0) {
+	    if (i != begin + numNewIndels) swap(*i, *(begin + numNewIndels));
+	    ++numNewIndels;
+	}
     }
+    const vector<IndelAllele>::iterator newEnd = begin + numNewIndels;
 
     // for each indel
-    //     if ( we're matched up to the previous insertion (or deletion) 
+    //     if ( we're matched up to the previous insertion (or deletion)
     //          and it's also an insertion or deletion )
     //         merge the indels
     //
@@ -629,61 +545,52 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
     // if there are spurious deletions at the start and end of the read, remove them
     // if there are spurious insertions after soft-clipped bases, make them soft clips
 
-    vector<pair<int, string> > newCigar;
+    vector<uint32_t>& newCigar = workspace.cigar;
+    newCigar.clear();
 
-    if (!softBegin.empty()) {
-	newCigar.push_back(make_pair(softBegin.size(), "S"));
+    if (softBegin) {
+	newCigar.push_back(packCigarOperation(softBegin, CIGAR_S));
     }
 
-    if (newIndels.empty()) {
+    if (numNewIndels == 0) {
 
-	int remainingReadBp = querySequence.size() - softEnd.size() - softBegin.size();
-	newCigar.push_back(make_pair(remainingReadBp, "M"));
+	int remainingReadBp = queryLength - softEnd - softBegin;
+	newCigar.push_back(packCigarOperation(remainingReadBp, CIGAR_M));
 
-	if (!softEnd.empty()) {
-	    newCigar.push_back(make_pair(softEnd.size(), "S"));
+	if (softEnd) {
+	    newCigar.push_back(packCigarOperation(softEnd, CIGAR_S));
 	}
 
-	cigar = joinCIGAR(newCigar);
-
-	// check if we're realigned
-	if (cigar == cigarbefore) {
-	    return false;
-	} else {
-	    return true;
-	}
+	return replaceCigar(cigar, newCigar);
     }
 
-    vector<IndelAllele>::iterator id = newIndels.begin();
+    vector<IndelAllele>::iterator id = begin;
     vector<IndelAllele>::iterator last = id++;
 
     if (last->position > 0) {
-	newCigar.push_back(make_pair(last->position, "M"));
-	newCigar.push_back(make_pair(last->length, (last->insertion ? "I" : "D")));
+	newCigar.push_back(packCigarOperation(last->position, CIGAR_M));
+	newCigar.push_back(packCigarOperation(last->length, (last->insertion ? CIGAR_I : CIGAR_D)));
     } else if (last->position == 0) { // discard floating indels
-	if (last->insertion) newCigar.push_back(make_pair(last->length, "S"));
-	else  newCigar.push_back(make_pair(last->length, "D"));
+	if (last->insertion) newCigar.push_back(packCigarOperation(last->length, CIGAR_S));
+	else  newCigar.push_back(packCigarOperation(last->length, CIGAR_D));
     } else {
 	cerr << "negative indel position " << *last << endl;
     }
 
     int lastend = last->insertion ? last->position : (last->position + last->length);
-    LEFTALIGN_DEBUG(*last << ",");
 
-    for (; id != newIndels.end(); ++id) {
+    for (; id != newEnd; ++id) {
 	IndelAllele& indel = *id;
 	if (indel.length == 0) continue; // remove 0-length indels
-	if (debug) cerr << indel << " " << *last << endl;
-	LEFTALIGN_DEBUG(indel << ",");
-	if ((id + 1) == newIndels.end()
-	    && (indel.insertion && indel.position == referenceSequence.size()
-		|| (!indel.insertion && indel.position + indel.length == referenceSequence.size()))
+	if ((id + 1) == newEnd
+	    && (indel.insertion && indel.position == referenceLength
+		|| (!indel.insertion && indel.position + indel.length == referenceLength))
 	    ) {
 	    if (indel.insertion) {
-		if (!newCigar.empty() && newCigar.back().second == "S") {
-		    newCigar.back().first += indel.length;
+		if (!newCigar.empty() && cigarOperation(newCigar.back()) == CIGAR_S) {
+		    extendCigarOperation(newCigar.back(), indel.length);
 		} else {
-		    newCigar.push_back(make_pair(indel.length, "S"));
+		    newCigar.push_back(packCigarOperation(indel.length, CIGAR_S));
 		}
 	    }
 	} else if (indel.position < lastend) {
@@ -692,55 +599,457 @@ bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequen
 	} else if (indel.position == lastend) {
 	    // how?
 	    if (indel.insertion == last->insertion) {
-		pair<int, string>& op = newCigar.back();
-		op.first += indel.length;
+		extendCigarOperation(newCigar.back(), indel.length);
 	    } else {
-		newCigar.push_back(make_pair(indel.length, (indel.insertion ? "I" : "D")));
+		newCigar.push_back(packCigarOperation(indel.length, (indel.insertion ? CIGAR_I : CIGAR_D)));
 	    }
         } else if (indel.position > lastend) {  // also catches differential indels, but with the same position
-	    if (!newCigar.empty() && newCigar.back().second == "M") newCigar.back().first += indel.position - lastend;
-	    else newCigar.push_back(make_pair(indel.position - lastend, "M"));
-            newCigar.push_back(make_pair(indel.length, (indel.insertion ? "I" : "D")));
+	    if (!newCigar.empty() && cigarOperation(newCigar.back()) == CIGAR_M) extendCigarOperation(newCigar.back(), indel.position - lastend);
+	    else newCigar.push_back(packCigarOperation(indel.position - lastend, CIGAR_M));
+            newCigar.push_back(packCigarOperation(indel.length, (indel.insertion ? CIGAR_I : CIGAR_D)));
         }
 
 	last = id;
 	lastend = last->insertion ? last->position : (last->position + last->length);
+    }
 
-	if (debug) {
-	    for (vector<pair<int, string> >::iterator c = newCigar.begin(); c != newCigar.end(); ++c)
-		cerr << c->first << c->second;
-	    cerr << endl;
-	}
+    int remainingReadBp = queryLength - (last->readPosition + last->readLength()) - softEnd;
+    if (remainingReadBp > 0) {
+	if (cigarOperation(newCigar.back()) == CIGAR_M) extendCigarOperation(newCigar.back(), remainingReadBp);
+	else newCigar.push_back(packCigarOperation(remainingReadBp, CIGAR_M));
+    }
+
+    if (cigarOperation(newCigar.back()) == CIGAR_D) newCigar.pop_back(); // remove trailing deletions
 
+    if (softEnd) {
+	if (cigarOperation(newCigar.back()) == CIGAR_S) extendCigarOperation(newCigar.back(), softEnd);
+	else newCigar.push_back(packCigarOperation(softEnd, CIGAR_S));
     }
 
-    int remainingReadBp = querySequence.size() - (last->readPosition + last->readLength()) - softEnd.size();
-    if (remainingReadBp > 0) {
-	if (debug) cerr << "bp remaining = " << remainingReadBp << endl;
-	if (newCigar.back().second == "M") newCigar.back().first += remainingReadBp;
-	else newCigar.push_back(make_pair(remainingReadBp, "M"));
+    return replaceCigar(cigar, newCigar);
+
+}
+
+bool leftAlign(string& querySequence, vector<uint32_t>& cigar, string& baseReferenceSequence, int& offset, bool /* debug */) {
+
+    LeftAlignWorkspace workspace;
+    return leftAlign(querySequence.data(), querySequence.size(), cigar, baseReferenceSequence.data(), baseReferenceSequence.size(), offset, workspace);
+
+}
+
+bool leftAlign(string& querySequence, string& cigar, string& baseReferenceSequence, int& offset, bool /* debug */) {
+
+    vector<uint32_t> packedCigar;
+    packCIGAR(cigar, packedCigar);
+    if (!leftAlign(querySequence, packedCigar, baseReferenceSequence, offset)) return false;
+    formatCIGAR(packedCigar, cigar);
+    return true;
+
+}
+
+// the query and the reference an alignment is normalized against
+struct AlignedSequences {
+    const char* query;
+    int queryLength;
+    const char* reference;
+    int referenceLength;
+};
+
+// the deleted reference bases or the inserted query bases
+static inline const char* indelSequence(const AlignedIndel& indel, const AlignedSequences& sequences) {
+    return indel.insertion ? sequences.query + indel.readPosition : sequences.reference + indel.position;
+}
+
+// the reference and query positions just past the indel
+static inline int indelEnd(const AlignedIndel& indel) {
+    return indel.insertion ? indel.position : indel.position + indel.length;
+}
+
+static inline int indelReadEnd(const AlignedIndel& indel) {
+    return indel.insertion ? indel.readPosition + indel.length : indel.readPosition;
+}
+
+// true if the length bases of sequence at position lie in the view and equal s
+static inline bool windowEquals(const char* sequence, int sequenceLength, int position, const char* s, int length) {
+    return position >= 0 && position + length <= sequenceLength && memcmp(sequence + position, s, length) == 0;
+}
+
+// true if the indel can move left by a whole unit of step bases: the sequence
+// repeats to the left in both the reference and the query
+static bool canShiftByUnit(const AlignedIndel& indel, int step, int barrier, const AlignedSequences& sequences) {
+    const int steppos = indel.position - step;
+    const int readsteppos = indel.readPosition - step;
+    if (steppos < barrier || readsteppos < 0) return false;
+    const char* sequence = indelSequence(indel, sequences);
+    return windowEquals(sequences.reference, sequences.referenceLength, steppos, sequence, indel.length)
+        && windowEquals(sequences.query, sequences.queryLength, readsteppos, sequence, indel.length);
+}
+
+// true if the indel can move left by one base: the matched base to its left
+// equals its last base, which is then exchanged with it
+static bool canExchangeFlank(const AlignedIndel& indel, int barrier, const AlignedSequences& sequences) {
+    const int steppos = indel.position - 1;
+    const int readsteppos = indel.readPosition - 1;
+    if (steppos < barrier || readsteppos < 0) return false;
+    const char last = indelSequence(indel, sequences)[indel.length - 1];
+    const char base = sequences.query[readsteppos];
+    return base == sequences.reference[steppos]
+        && sequences.referenceLength > steppos + indel.length
+        && sequences.reference[steppos + indel.length] == last
+        && base == last;
+}
+
+// moves the indel as far left as it goes without passing the barrier, the
+// reference position the previous indel ends at.  A deletion slides along
+// the run of its period in the reference, one exchanged base at a time; a
+// whole-unit shift never gets a deletion further.  An insertion also tries
+// the units of its length, as leftAlign does.
+static void shiftIndelLeft(AlignedIndel& indel, int barrier, const AlignedSequences& sequences) {
+    if (barrier < 0) barrier = 0;
+    bool moved;
+    do {
+        moved = false;
+        if (indel.insertion) {
+            for (int step = 1; step <= indel.length; ++step) {
+                if (indel.length % step != 0) continue;
+                while (canShiftByUnit(indel, step, barrier, sequences)) {
+                    indel.position -= step;
+                    indel.readPosition -= step;
+                    moved = true;
+                }
+            }
+        }
+        while (canExchangeFlank(indel, barrier, sequences)) {
+            --indel.position;
+            --indel.readPosition;
+            moved = true;
+        }
+    } while (moved && indel.insertion);
+}
+
+// true if the previous indel is a homopolymer separated from the indel by the
+// same homopolymer, so that it can float right and merge with it
+static bool canFloatRight(const AlignedIndel& previous, const AlignedIndel& indel, const AlignedSequences& sequences) {
+    if (previous.insertion) {
+        if (previous.position >= indel.position || previous.readPosition >= indel.readPosition) return false;
+    } else {
+        if (previous.position + previous.length >= indel.position || previous.readPosition >= indel.readPosition) return false;
+    }
+    const char* sequence = indelSequence(previous, sequences);
+    if (!isHomopolymer(sequence, previous.length)) return false;
+    const int between = indel.position - indelEnd(previous);
+    const int start = indelEnd(previous);
+    const int readStart = indelReadEnd(previous);
+    if (start + between > sequences.referenceLength || readStart + between > sequences.queryLength) return false;
+    const char* seq = sequences.reference + start;
+    const char* readseq = sequences.query + readStart;
+    // the floated insertion takes its bases from the query
+    return sequence[0] == seq[0] && isHomopolymer(seq, between) && isHomopolymer(readseq, between)
+        && (!previous.insertion || readseq[0] == sequence[0]);
+}
+
+// the number of bases at the end of the previous indel and the start of the
+// indel of the other kind that, together with the matches between them, pair
+// up as matches.  Returns the largest such count, 0 if there is none.
+static int countOverlappingBases(const AlignedIndel& previous, const AlignedIndel& indel, const AlignedSequences& sequences) {
+    const int between = indel.position - indelEnd(previous);
+    const char* lastSequence = previous.insertion ? sequences.query : sequences.reference;
+    const int lastLength = previous.insertion ? sequences.queryLength : sequences.referenceLength;
+    const int lastStart = previous.insertion ? previous.readPosition : previous.position;
+    const char* otherSequence = previous.insertion ? sequences.reference : sequences.query;
+    const int otherLength = previous.insertion ? sequences.referenceLength : sequences.queryLength;
+    const int otherStart = previous.insertion ? previous.position : previous.readPosition;
+    for (int i = min(previous.length, indel.length); i > 0; --i) {
+        const int length = between + i;
+        if (otherStart + length > otherLength) continue;
+        if (windowEquals(lastSequence, lastLength, lastStart + previous.length - i, otherSequence + otherStart, length)) return i;
+    }
+    return 0;
+}
+
+// adds the indel to the settled indels: shifts it left, then merges it with
+// or trims it against the previous indel, settling the result again.  Sets
+// interacted if it did merge or trim.
+static void settleIndel(AlignedIndel indel, vector<AlignedIndel>& settled, const AlignedSequences& sequences, bool& interacted) {
+    while (indel.length > 0) {
+        shiftIndelLeft(indel, settled.empty() ? 0 : indelEnd(settled.back()), sequences);
+        if (settled.empty()) break;
+        AlignedIndel& previous = settled.back();
+        if (previous.insertion == indel.insertion) {
+            if (indel.position == indelEnd(previous)) {
+                indel.position = previous.position;
+                indel.readPosition = previous.readPosition;
+            } else if (canFloatRight(previous, indel, sequences)) {
+                if (indel.insertion) indel.readPosition -= previous.length;
+                else indel.position -= previous.length;
+            } else {
+                break;
+            }
+            interacted = true;
+            indel.length += previous.length;
+            settled.pop_back();
+        } else {
+            const int overlap = countOverlappingBases(previous, indel, sequences);
+            if (overlap == 0) break;
+            interacted = true;
+            indel.length -= overlap;
+            if (indel.insertion) indel.readPosition += overlap;
+            else indel.position += overlap;
+            AlignedIndel shortened = previous;
+            shortened.length -= overlap;
+            settled.pop_back();
+            if (shortened.length > 0) settleIndel(shortened, settled, sequences, interacted);
+        }
     }
+    if (indel.length > 0) settled.push_back(indel);
+}
 
-    if (newCigar.back().second == "D") newCigar.pop_back(); // remove trailing deletions
+// settles the indels in order, keeping those of non-zero length
+static void settleIndels(vector<AlignedIndel>& indels, vector<AlignedIndel>& settled, const AlignedSequences& sequences, bool& interacted) {
+    settled.clear();
+    for (vector<AlignedIndel>::const_iterator i = indels.begin(); i != indels.end(); ++i) {
+        if (i->length > 0) settleIndel(*i, settled, sequences, interacted);
+    }
+}
 
-    if (!softEnd.empty()) {
-	if (newCigar.back().second == "S") newCigar.back().first += softEnd.size();
-	else newCigar.push_back(make_pair(softEnd.size(), "S"));
+// true if two neighboring indels are separated by no more matched reference
+// bases than the longer of them is long
+static bool hasCrowdedIndels(const vector<AlignedIndel>& settled) {
+    for (vector<AlignedIndel>::const_iterator i = settled.begin(); i + 1 < settled.end(); ++i) {
+        const AlignedIndel& next = *(i + 1);
+        if (next.position - indelEnd(*i) <= max(i->length, next.length)) return true;
     }
+    return false;
+}
 
-    LEFTALIGN_DEBUG(endl);
+// calls leftAlign until the cigar stops changing, at most maxiterations
+// times.  Sets changed if the first call changed the cigar, and returns false
+// if the last call still did.
+static bool iterateLeftAlign(const char* querySequence, size_t queryLength, vector<uint32_t>& cigar,
+                             const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace,
+                             int maxiterations, bool& changed) {
+    changed = leftAlign(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace);
+    if (!changed) return true;
+    while (leftAlign(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace) && --maxiterations > 0) { }
+    return maxiterations > 0;
+}
 
-    cigar = joinCIGAR(newCigar);
+// shrinks a deletion when the read flanking it also matches the reference
+// closer to it, taking the parsimonious explanation as leftAlign does.
+// Returns true if the alignment changed.
+static bool bringInDeletions(vector<AlignedIndel>& indels, AlignedSequences& sequences, int& offset, int& softBegin, int& softEnd) {
+
+    bool changed = false;
+    if (indels.empty()) return false;
+    const vector<AlignedIndel>::iterator begin = indels.begin();
+    const vector<AlignedIndel>::iterator end = indels.end();
+    vector<AlignedIndel>::iterator del = begin;
+    for (vector<AlignedIndel>::iterator a = begin; a != end; ++a) {
+	if (!a->insertion && a->length) del = a;
+	if (del->insertion) continue;
+	int insertedBpBefore = 0;
+	int deletedBpBefore = 0;
+	for (vector<AlignedIndel>::iterator i = begin; i != del; ++i) {
+	    if (i->insertion) insertedBpBefore += i->length;
+	    else deletedBpBefore += i->length;
+	}
+	AlignedIndel& indel = *del;
+	int minsize = indel.length;
+	int flankingLength = indel.readPosition;
+	const size_t flankingSize = min(flankingLength, sequences.queryLength);
+
+	size_t p = reverseFind(sequences.reference, min(indel.position + indel.length, sequences.referenceLength), sequences.query, flankingSize);
+	if (p != string::npos) {
+	    minsize = (indel.position + indel.length) - ((int) p + flankingLength);
+	}
 
-    LEFTALIGN_DEBUG(cigar << endl);
+	if (minsize >= 0 && minsize < indel.length) {
+	    int softdiff = softBegin;
+	    if (softBegin) {
+		if (flankingLength < softBegin) softdiff = 0;
+		else softBegin = 0;
+	    }
+	    int diff = indel.length - minsize - softdiff + deletedBpBefore - insertedBpBefore;
+	    offset += diff;
+	    indel.length = minsize;
+	    indel.position = flankingLength;
+	    indel.readPosition = indel.position;
+	    checkPosition(diff, sequences.referenceLength);
+	    sequences.reference += diff;
+	    sequences.referenceLength -= diff;
+	    for (vector<AlignedIndel>::iterator i = begin; i != end; ++i) {
+		if (i < del) i->length = 0;
+		else if (i > del) i->position -= diff;
+	    }
+	    changed = true;
+	}
 
-    // check if we're realigned
-    if (cigar == cigarbefore) {
+	if (indel.length > 0) {
+	    int minsize = indel.length + 1;
+	    int flankingLength = sequences.queryLength - indel.readPosition;
+	    const size_t flankingSize = substringLength(sequences.queryLength, indel.readPosition, flankingLength);
+
+	    size_t p = forwardFind(sequences.reference, sequences.referenceLength, sequences.query + indel.readPosition, flankingSize, indel.position);
+	    if (p != string::npos) {
+		minsize = (int) p - indel.position;
+	    }
+
+	    if (minsize >= 0 && minsize <= indel.length) {
+		if (minsize < indel.length) changed = true;
+		indel.length = minsize;
+		if (softEnd) {
+		    if (flankingLength < softEnd) checkPosition(flankingLength - softEnd, softEnd);
+		    else { softEnd = 0; changed = true; }
+		}
+		for (vector<AlignedIndel>::iterator i = del + 1; i != end; ++i) {
+		    if (i->length) changed = true;
+		    i->length = 0;
+		}
+	    }
+	}
+    }
+    return changed;
+}
+
+// Left-aligns the indels of the alignment in one sweep.  Each indel is
+// shifted left along the repeat it lies in, then merged with the previous
+// indel of the same kind when they meet, or trimmed against the previous
+// indel of the other kind where their bases pair up as matches.  Whatever a
+// merge or trim changes is settled again before the sweep moves on.
+//
+// This reaches the alignment leftAlign settles on as long as the indels stay
+// apart.  Indels that merge, trim or end up crowded together are settled in a
+// different order by leftAlign, which can give another alignment.  The sweep
+// then gives up and returns false, leaving the cigar and the offset as they
+// were.  Otherwise it sets changed if the cigar changed and returns true.
+//
+static bool sweepIndels(const char* querySequence, size_t queryLength, vector<uint32_t>& cigar,
+                        const char* baseReferenceSequence, size_t baseReferenceLength, int& offset, LeftAlignWorkspace& workspace,
+                        bool& changed) {
+
+    checkPosition(offset, baseReferenceLength);
+    const int originalOffset = offset;
+    AlignedSequences sequences;
+    sequences.query = querySequence;
+    sequences.queryLength = queryLength;
+    sequences.reference = baseReferenceSequence + offset;
+    sequences.referenceLength = baseReferenceLength - offset;
+
+    vector<AlignedIndel>& indels = workspace.alignedIndels;
+    vector<AlignedIndel>& settled = workspace.settledIndels;
+    indels.clear();
+    settled.clear();
+
+    int rp = 0;  // read position, 0-based relative to read
+    int sp = 0;  // sequence position
+    int softBegin = 0;
+    int softEnd = 0;
+    bool interacted = false;
+
+    for (vector<uint32_t>::const_iterator c = cigar.begin(); c != cigar.end(); ++c) {
+        const int l = cigarLength(*c);
+        AlignedIndel indel;
+        switch (cigarOperation(*c)) {
+        case CIGAR_M:
+        case CIGAR_EQ:
+        case CIGAR_X:
+            sp += l;
+            rp += l;
+            break;
+        case CIGAR_D:
+        case CIGAR_I:
+            indel.insertion = cigarOperation(*c) == CIGAR_I;
+            indel.length = l;
+            indel.position = sp;
+            indel.readPosition = rp;
+            checkPosition(indelEnd(indel), sequences.referenceLength);
+            checkPosition(indelReadEnd(indel), queryLength);
+            settleIndel(indel, settled, sequences, interacted);
+            if (indel.insertion) rp += l;
+            else sp += l;
+            break;
+        case CIGAR_S:
+            if (rp == 0) softBegin = min(l, (int) queryLength);
+            else softEnd = substringLength(queryLength, queryLength - l, l);
+            rp += l;
+            break;
+        case CIGAR_N:
+            sp += l;
+            break;
+        }
+    }
+
+    // taking in a deletion moves the alignment, which may let the indels
+    // settle further
+    while (!settled.empty() && bringInDeletions(settled, sequences, offset, softBegin, softEnd)) {
+        indels.swap(settled);
+        settleIndels(indels, settled, sequences, interacted);
+    }
+
+    if (interacted || hasCrowdedIndels(settled)) {
+        offset = originalOffset;
         return false;
-    } else {
+    }
+
+    vector<uint32_t>& newCigar = workspace.cigar;
+    newCigar.clear();
+
+    if (softBegin) newCigar.push_back(packCigarOperation(softBegin, CIGAR_S));
+
+    if (settled.empty()) {
+        newCigar.push_back(packCigarOperation(queryLength - softEnd - softBegin, CIGAR_M));
+        if (softEnd) newCigar.push_back(packCigarOperation(softEnd, CIGAR_S));
+        changed = replaceCigar(cigar, newCigar);
         return true;
     }
 
+    // a deletion at the start of the alignment moves its start instead
+    int start = 0;
+    int lastend = 0;
+    int lastReadEnd = softBegin;
+    bool first = true;
+    for (vector<AlignedIndel>::const_iterator i = settled.begin(); i != settled.end(); ++i) {
+        if (!i->insertion && i->position == 0) {
+            offset += i->length;
+            start = lastend = i->length;
+            continue;
+        }
+        const bool last = i + 1 == settled.end();
+        if (i->position > lastend) appendCigarOperation(newCigar, i->position - lastend, CIGAR_M);
+        if (i->insertion && ((first && i->position == start) || (!first && last && i->position == sequences.referenceLength))) {
+            appendCigarOperation(newCigar, i->length, CIGAR_S);  // floating insertions at the ends are soft clipped
+        } else if (!i->insertion && !first && last && i->position + i->length == sequences.referenceLength) {
+            // drop a deletion at the end of the alignment
+        } else {
+            appendCigarOperation(newCigar, i->length, i->insertion ? CIGAR_I : CIGAR_D);
+        }
+        lastend = indelEnd(*i);
+        lastReadEnd = indelReadEnd(*i);
+        first = false;
+    }
+
+    const int remainingReadBp = queryLength - lastReadEnd - softEnd;
+    if (remainingReadBp > 0) appendCigarOperation(newCigar, remainingReadBp, CIGAR_M);
+    if (cigarOperation(newCigar.back()) == CIGAR_D) newCigar.pop_back(); // remove trailing deletions
+    if (softEnd) appendCigarOperation(newCigar, softEnd, CIGAR_S);
+
+    changed = replaceCigar(cigar, newCigar);
+    return true;
+
+}
+
+// Left-aligns the indels of the alignment in one sweep, falling back to
+// calling leftAlign until the cigar stops changing when the sweep gives up.
+// Returns true if the cigar changed.
+//
+bool normalizeIndels(const char* querySequence, size_t queryLength, vector<uint32_t>& cigar,
+                     const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace) {
+
+    bool changed = false;
+    if (!sweepIndels(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace, changed))
+        iterateLeftAlign(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace, 20, changed);
+    return changed;
+
 }
 
 int countMismatches(string& querySequence, string& cigar, string referenceSequence) {
@@ -776,29 +1085,122 @@ int countMismatches(string& querySequence, string& cigar, string referenceSequen
 
 }
 
-// Iteratively left-aligns the indels in the alignment until we have a stable
-// realignment.  Returns true on realignment success or non-realignment.
-// Returns false if we exceed the maximum number of realignment iterations.
+// Tells whether normalizeIndels would leave the alignment as it is, without
+// rebuilding it.  An alignment without indels is normalized, and so is one
+// with a single indel between matches that cannot move left, unless it is a
+// deletion the parsimony step would shrink because the read flanking it also
+// matches the reference closer to it.
 //
-bool stablyLeftAlign(string querySequence, string& cigar, string referenceSequence, int& offset, int maxiterations, bool debug) {
+bool isNormalized(const char* querySequence, size_t queryLength, const vector<uint32_t>& cigar,
+                  const char* referenceSequence, size_t referenceLength) {
 
-    if (!leftAlign(querySequence, cigar, referenceSequence, offset)) {
+    AlignedSequences sequences;
+    sequences.query = querySequence;
+    sequences.queryLength = queryLength;
+    sequences.reference = referenceSequence;
+    sequences.referenceLength = referenceLength;
 
-        LEFTALIGN_DEBUG("did not realign" << endl);
-        return true;
+    int rp = 0;  // read position, 0-based relative to read
+    int sp = 0;  // sequence position
+    int softEnd = 0;
+    int numIndels = 0;
+    int previousOperation = -1;
+    bool matchAfterIndel = false;
+    AlignedIndel indel = AlignedIndel();
+
+    // [S] M [I or D M] [S]
+    for (vector<uint32_t>::const_iterator c = cigar.begin(); c != cigar.end(); ++c) {
+        const int l = cigarLength(*c);
+        const int t = cigarOperation(*c);
+        if (l == 0) return false;
+        switch (t) {
+        case CIGAR_S:
+            if (c + 1 == cigar.end() && c != cigar.begin()) softEnd = l;
+            else if (c != cigar.begin()) return false;
+            rp += l;
+            break;
+        case CIGAR_M:
+            if (previousOperation == CIGAR_M) return false;
+            if (numIndels) matchAfterIndel = true;
+            sp += l;
+            rp += l;
+            break;
+        case CIGAR_I:
+        case CIGAR_D:
+            if (numIndels++ || previousOperation != CIGAR_M) return false;
+            indel.insertion = t == CIGAR_I;
+            indel.length = l;
+            indel.position = sp;
+            indel.readPosition = rp;
+            if (indel.insertion) rp += l;
+            else sp += l;
+            break;
+        default:
+            return false;
+        }
+        previousOperation = t;
+    }
 
-    } else {
+    if (rp != (int) queryLength || sp > (int) referenceLength) return false;
+    if (numIndels == 0) return true;
+    if (!matchAfterIndel) return false;
 
-        while (leftAlign(querySequence, cigar, referenceSequence, offset) && --maxiterations > 0) {
-            LEFTALIGN_DEBUG("realigning ..." << endl);
+    // no shift left
+    if (canExchangeFlank(indel, 0, sequences)) return false;
+    if (indel.insertion) {
+        for (int step = 1; step <= indel.length; ++step) {
+            if (indel.length % step == 0 && canShiftByUnit(indel, step, 0, sequences)) return false;
         }
+        return true;
+    }
 
-        if (maxiterations <= 0) {
-            return false;
-        } else {
-            return true;
-        }
+    // nothing for bringInDeletions: the read before the deletion does not
+    // match the reference further right ...
+    const int deletionEnd = indel.position + indel.length;
+    for (int p = max(0, indel.position - indel.readPosition + 1); p <= deletionEnd - indel.readPosition; ++p) {
+        if (windowEquals(referenceSequence, min(deletionEnd, sequences.referenceLength), p, querySequence, indel.readPosition)) return false;
     }
+    // ... and the read after it does not match the reference further left
+    const int flankingLength = queryLength - indel.readPosition;
+    for (int p = indel.position; p <= deletionEnd; ++p) {
+        if (p == deletionEnd && softEnd == 0) break;
+        if (windowEquals(referenceSequence, sequences.referenceLength, p, querySequence + indel.readPosition, flankingLength)) return false;
+    }
+    return true;
+
+}
+
+// Left-aligns the indels in the alignment until we have a stable
+// realignment.  The sweep of normalizeIndels gets there in one pass when the
+// indels stay apart; otherwise leftAlign is called until nothing changes.
+// Returns false if it still changed the cigar after maxiterations calls.
+//
+bool stablyLeftAlign(const char* querySequence, size_t queryLength, vector<uint32_t>& cigar,
+                     const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace, int maxiterations) {
+
+    bool changed = false;
+    if (sweepIndels(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace, changed)) return true;
+    return iterateLeftAlign(querySequence, queryLength, cigar, referenceSequence, referenceLength, offset, workspace, maxiterations, changed);
+
+}
+
+bool stablyLeftAlign(string querySequence, vector<uint32_t>& cigar, string referenceSequence, int& offset, int maxiterations, bool debug) {
+
+    LeftAlignWorkspace workspace;
+    const bool stable = stablyLeftAlign(querySequence.data(), querySequence.size(), cigar, referenceSequence.data(), referenceSequence.size(), offset, workspace, maxiterations);
+    if (!stable && debug) cerr << "stablyLeftAlign: no stable alignment after " << maxiterations << " iterations" << endl;
+    return stable;
+
+}
+
+bool stablyLeftAlign(string querySequence, string& cigar, string referenceSequence, int& offset, int maxiterations, bool debug) {
+
+    vector<uint32_t> packedCigar;
+    packCIGAR(cigar, packedCigar);
+    bool stable = stablyLeftAlign(querySequence, packedCigar, referenceSequence, offset, maxiterations, debug);
+    formatCIGAR(packedCigar, cigar);
+    return stable;
+
 }
 
 string mergeCIGAR(const string& c1, const string& c2) {
@@ -851,3 +1253,36 @@ string joinCIGAR(const vector<pair<int, string> >& cigar) {
     }
     return cigarStr;
 }
+
+void packCIGAR(const string& cigarStr, vector<uint32_t>& cigar) {
+    cigar.clear();
+    uint32_t length = 0;
+    // strings go [Number][Type] ...
+    for (string::const_iterator s = cigarStr.begin(); s != cigarStr.end(); ++s) {
+        char c = *s;
+        if (isdigit(c)) {
+            length = length * 10 + (c - '0');
+        } else {
+            const char* operation = strchr("MIDNSHP=X", c);
+            if (c && operation) {
+                cigar.push_back(packCigarOperation(length, operation - "MIDNSHP=X"));
+            }
+            length = 0;
+        }
+    }
+}
+
+void formatCIGAR(const vector<uint32_t>& cigar, string& cigarStr) {
+    cigarStr.clear();
+    char digits[16];
+    for (vector<uint32_t>::const_iterator c = cigar.begin(); c != cigar.end(); ++c) {
+        int n = 0;
+        uint32_t length = cigarLength(*c);
+        do {
+            digits[n++] = '0' + length % 10;
+            length /= 10;
+        } while (length);
+        while (n) cigarStr += digits[--n];
+        cigarStr += cigarOperationChar(cigarOperation(*c));
+    }
+}
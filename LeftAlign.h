@@ -7,6 +7,7 @@
 #include <list>
 #include <utility>
 #include <sstream>
+#include <stdint.h>
 
 #include "IndelAllele.h"
 #include "convert.h"
@@ -20,13 +21,90 @@
 
 using namespace std;
 
+// the operations of a packed cigar, numbered as in BAM
+enum CigarOperation {
+    CIGAR_M = 0,
+    CIGAR_I,
+    CIGAR_D,
+    CIGAR_N,
+    CIGAR_S,
+    CIGAR_H,
+    CIGAR_P,
+    CIGAR_EQ,
+    CIGAR_X
+};
+
+// a packed cigar operation holds the length in the upper 28 bits and the operation in the lower 4, as in BAM
+inline uint32_t packCigarOperation(uint32_t length, int operation) { return (length << 4) | operation; }
+inline uint32_t cigarLength(uint32_t packed) { return packed >> 4; }
+inline int cigarOperation(uint32_t packed) { return packed & 0xf; }
+inline char cigarOperationChar(int operation) { return "MIDNSHP=X"[operation]; }
+
+// adds length bases to a packed cigar operation
+inline void extendCigarOperation(uint32_t& packed, uint32_t length) { packed += length << 4; }
+
+// appends the operation to the packed cigar, extending the last operation if it is the same
+inline void appendCigarOperation(vector<uint32_t>& cigar, uint32_t length, int operation) {
+    if (!cigar.empty() && cigarOperation(cigar.back()) == operation) extendCigarOperation(cigar.back(), length);
+    else cigar.push_back(packCigarOperation(length, operation));
+}
+
+// an indel of an alignment being normalized. Its sequence is not copied: it is
+// the window of the reference (deletion) or the query (insertion) at its position.
+struct AlignedIndel {
+    bool insertion;
+    int length;
+    int position;      // in the reference
+    int readPosition;  // in the query
+};
+
+// the buffers the left-aligner reuses from one call to the next
+struct LeftAlignWorkspace {
+    vector<IndelAllele> indels;
+    vector<AlignedIndel> alignedIndels;
+    vector<AlignedIndel> settledIndels;
+    vector<uint32_t> cigar;
+    string lastOverlap;
+    string indelOverlap;
+};
+
+// Deprecated: one step of the iterating left-aligner, which has to be called
+// until the cigar stops changing. Use normalizeIndels. The leftAlign overloads
+// are only kept for source compatibility and as the benchmark baseline.
+//
+// left-aligns the indels of a packed cigar against views of the query and
+// reference, allocating only while the workspace grows
+bool leftAlign(const char* alternateQuery, size_t queryLength, vector<uint32_t>& cigar,
+               const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace);
+// left-shifts and merges all the indels of a packed cigar in one sweep, and
+// gives the alignment calling leftAlign until the cigar stops changing would.
+// Indels that meet or crowd together still go through the leftAlign loop.
+bool normalizeIndels(const char* alternateQuery, size_t queryLength, vector<uint32_t>& cigar,
+                     const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace);
+// returns true if normalizeIndels would leave the cigar as it is. This is only
+// worked out for cigars with at most one indel, the others return false.
+bool isNormalized(const char* alternateQuery, size_t queryLength, const vector<uint32_t>& cigar,
+                  const char* referenceSequence, size_t referenceLength);
+// normalizes the indels of the cigar as normalizeIndels does. Returns false
+// if leftAlign was still changing the cigar after maxiterations calls; the
+// sweep alone always gives a stable alignment. With debug, the string
+// overloads report that on stderr.
+bool stablyLeftAlign(const char* alternateQuery, size_t queryLength, vector<uint32_t>& cigar,
+                     const char* referenceSequence, size_t referenceLength, int& offset, LeftAlignWorkspace& workspace, int maxiterations = 20);
+
+// deprecated, see above; debug is ignored
 bool leftAlign(string& alternateQuery, string& cigar, string& referenceSequence, int& offset, bool debug = false);
+bool leftAlign(string& alternateQuery, vector<uint32_t>& cigar, string& referenceSequence, int& offset, bool debug = false);
 bool stablyLeftAlign(string alternateQuery, string& cigar, string referenceSequence, int& offset, int maxiterations = 20, bool debug = false);
+bool stablyLeftAlign(string alternateQuery, vector<uint32_t>& cigar, string referenceSequence, int& offset, int maxiterations = 20, bool debug = false);
 int countMismatches(string& alternateQuery, string& cigar, string& referenceSequence);
 
 string mergeCIGAR(const string& c1, const string& c2);
 vector<pair<int, string> > splitCIGAR(const string& cigarStr);
 string joinCIGAR(const vector<pair<int, string> >& cigar);
+// converts between cigar strings and packed cigars, operations other than MIDNSHP=X are dropped
+void packCIGAR(const string& cigarStr, vector<uint32_t>& cigar);
+void formatCIGAR(const vector<uint32_t>& cigar, string& cigarStr);
 
 
 #endif
@@ -1,5 +1,7 @@
 #include "Repeats.h"
 
+#include <string.h>
+
 map<string, int> repeatCounts(long int position, const string& sequence, int maxsize) {
     map<string, int> counts;
     for (int i = 1; i <= maxsize; ++i) {
@@ -67,3 +69,63 @@ bool isRepeatUnit(const string& seq, const string& unit) {
     }
 
 }
+
+bool isRepeatUnit(const char* seq, int length, const char* unit, int unitLength) {
+
+    if (length % unitLength != 0 || memcmp(seq, unit, unitLength) != 0) {
+	return false;
+    }
+    // the remaining copies repeat the first one if seq has period unitLength
+    return memcmp(seq + unitLength, seq, length - unitLength) == 0;
+
+}
+
+// A unit of i bases starting at position p repeats wherever seq[q] == seq[q + i].
+// For every period the scan keeps the maximal run [start, end) of such q around
+// p: the copies of the unit to the left of p fit into p - start bases, the
+// copies to the right into end - p + i bases. A run is measured once when the
+// scan enters it, so every period costs a single pass over the sequence.
+void annotateTandemRepeats(const string& seq, int maxsize, vector<TandemRepeat>& repeats) {
+
+    const int length = seq.size();
+    const char* s = seq.data();
+
+    repeats.resize(length + 1);
+
+    // the run of every period around the current position, runEnd is -1 before the first run
+    vector<int> runStart(maxsize + 1, 0);
+    vector<int> runEnd(maxsize + 1, -1);
+
+    for (int p = 0; p <= length; ++p) {
+
+        TandemRepeat& repeat = repeats[p];
+        repeat.unitLength = 0;
+        repeat.unitOffset = p;
+        repeat.count = 0;
+
+        // the last unit kept, longer units consisting of its copies are redundant
+        int prev = 0;
+
+        for (int i = 1; i <= maxsize && p + i <= length; ++i) {
+
+            // the previous run ended before p, a new one starts here
+            if (p > runEnd[i]) {
+                int end = p;
+                while (end + i < length && s[end] == s[end + i]) ++end;
+                runStart[i] = p;
+                runEnd[i] = end;
+            }
+
+            const int leftsteps  = (p - runStart[i]) / i;
+            const int rightsteps = (runEnd[i] - p + i) / i;
+            if (leftsteps + rightsteps <= 1) continue;
+
+            // skip units made of whole copies of the previous unit
+            if (prev && i % prev == 0 && runEnd[prev] - p >= i - prev) continue;
+
+            repeat.unitLength = i;
+            repeat.count = leftsteps + rightsteps;
+            prev = i;
+        }
+    }
+}
@@ -1,8 +1,25 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
 
 using namespace std;
 
+// the dominant tandem repeat at a position of a sequence. The unit is
+// seq.substr(unitOffset, unitLength), count is the number of copies of the
+// unit in the run around the position. unitLength is 0 when there is none.
+struct TandemRepeat {
+    int unitLength;
+    int unitOffset;
+    int count;
+};
+
 map<string, int> repeatCounts(long int pos, const string& seq, int maxsize);
 bool isRepeatUnit(const string& seq, const string& unit);
+// isRepeatUnit on the sequences in place, without temporary strings
+bool isRepeatUnit(const char* seq, int length, const char* unit, int unitLength);
+
+// annotates every position of seq (and the end of the sequence) with the
+// longest non-redundant repeat unit of at most maxsize bases that repeatCounts
+// reports there, in time linear in the sequence length
+void annotateTandemRepeats(const string& seq, int maxsize, vector<TandemRepeat>& repeats);
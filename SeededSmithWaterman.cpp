@@ -0,0 +1,137 @@
+#include "SeededSmithWaterman.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+
+// define our static constants
+const unsigned int CSeededSmithWaterman::MAX_KMER_OCCURRENCES = 16;
+const unsigned int CSeededSmithWaterman::MIN_SEED_HITS        = 2;
+const unsigned int CSeededSmithWaterman::MIN_QUERY_BANDWIDTHS = 12;
+
+// constructor
+CSeededSmithWaterman::CSeededSmithWaterman(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty, unsigned int bandWidth, unsigned int kmerLength)
+    : IsBanded(false)
+    , BestScore(0.0f)
+    , FullAligner(matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty)
+    , mBandedAligner(matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty, bandWidth | 1)
+    , mBandwidth(bandWidth | 1)
+    , mKmerLength(kmerLength)
+{
+    if((kmerLength == 0) || (kmerLength > 16)) {
+	cout << "ERROR: The seed k-mer length must be between 1 and 16, got " << kmerLength << "." << endl;
+	exit(1);
+    }
+}
+
+// aligns the query sequence to the reference, within a band around the seeded diagonal when there is one
+void CSeededSmithWaterman::Align(unsigned int& referenceAl, string& cigarAl, const string& s1, const string& s2) {
+
+    pair< pair<unsigned int, unsigned int>, pair<unsigned int, unsigned int> > hr;
+    IsBanded = (s2.length() >= MIN_QUERY_BANDWIDTHS * mBandwidth) && FindHashRegion(hr, s1, s2);
+    if(!IsBanded) {
+	FullAligner.Align(referenceAl, cigarAl, s1, s2);
+	BestScore = FullAligner.BestScore;
+	return;
+    }
+
+    // the banded aligner starts where the diagonal leaves the matrix edge, and expects the reference to cover the
+    // band down to the last query base. Reference padding gives it both, and since N never scores, no alignment enters it.
+    const int diagonal          = (int) hr.first.first - (int) hr.second.first;
+    const unsigned int leading  = max(0, -diagonal);
+    const unsigned int trailing = max(0, (int) s2.length() + diagonal + (int) (mBandwidth / 2) - (int) s1.length());
+    if((leading == 0) && (trailing == 0)) {
+	mBandedAligner.Align(referenceAl, cigarAl, s1, s2, hr);
+	BestScore = mBandedAligner.BestScore;
+	return;
+    }
+
+    mPaddedReference.assign(leading, 'N');
+    mPaddedReference.append(s1);
+    mPaddedReference.append(trailing, 'N');
+    hr.first.first  += leading;
+    hr.first.second += leading;
+
+    mBandedAligner.Align(referenceAl, cigarAl, mPaddedReference, s2, hr);
+    BestScore = mBandedAligner.BestScore;
+    referenceAl -= leading;
+}
+
+// finds the diagonal sharing the most k-mers and returns its leftmost shared k-mer as the hash region
+bool CSeededSmithWaterman::FindHashRegion(pair< pair<unsigned int, unsigned int>, pair<unsigned int, unsigned int> >& hr, const string& s1, const string& s2) {
+
+    PackKmers(mReferenceKmers, s1);
+    PackKmers(mQueryKmers, s2);
+    sort(mReferenceKmers.begin(), mReferenceKmers.end());
+
+    // every reference occurrence of a query k-mer votes for its diagonal, offset by the query length to stay positive
+    const uint64_t diagonalOffset = s2.length();
+    mHits.clear();
+    for(vector<uint64_t>::const_iterator q = mQueryKmers.begin(); q != mQueryKmers.end(); ++q) {
+	const uint64_t kmer          = *q >> 32;
+	const uint64_t queryPosition = (uint32_t) *q;
+
+	vector<uint64_t>::iterator first = lower_bound(mReferenceKmers.begin(), mReferenceKmers.end(), kmer << 32);
+	vector<uint64_t>::iterator last  = lower_bound(first, mReferenceKmers.end(), (kmer + 1) << 32);
+	if((first == last) || ((unsigned int) (last - first) > MAX_KMER_OCCURRENCES)) continue;
+
+	for(; first != last; ++first) {
+	    const uint64_t diagonal = (uint32_t) *first + diagonalOffset - queryPosition;
+	    mHits.push_back((diagonal << 32) | queryPosition);
+	}
+    }
+
+    // the hits of a diagonal are now adjacent, the first one being its leftmost seed. Within repeats several
+    // diagonals tie, the one laying the most query bases over the reference is kept.
+    sort(mHits.begin(), mHits.end());
+    unsigned int bestHit = 0, bestVotes = 0;
+    int bestOverlap = 0;
+    for(unsigned int h = 0; h < mHits.size(); ) {
+	unsigned int next = h + 1;
+	while((next < mHits.size()) && ((mHits[next] >> 32) == (mHits[h] >> 32))) next++;
+
+	const int diagonal = (int) ((mHits[h] >> 32) - diagonalOffset);
+	const int overlap  = min((int) s2.length(), (int) s1.length() - diagonal) - max(0, -diagonal);
+	if(((next - h) > bestVotes) || (((next - h) == bestVotes) && (overlap > bestOverlap))) {
+	    bestHit     = h;
+	    bestVotes   = next - h;
+	    bestOverlap = overlap;
+	}
+	h = next;
+    }
+    if(bestVotes < MIN_SEED_HITS) return false;
+
+    const int diagonal                   = (int) ((mHits[bestHit] >> 32) - diagonalOffset);
+    const unsigned int queryPosition     = (uint32_t) mHits[bestHit];
+    const unsigned int referencePosition = queryPosition + diagonal;
+
+    hr.first.first   = referencePosition;
+    hr.first.second  = referencePosition + mKmerLength - 1;
+    hr.second.first  = queryPosition;
+    hr.second.second = queryPosition + mKmerLength - 1;
+    return true;
+}
+
+// packs the k-mers of the sequence as (k-mer << 32 | position), skipping those with bases other than ACGT
+void CSeededSmithWaterman::PackKmers(vector<uint64_t>& kmers, const string& sequence) const {
+
+    kmers.clear();
+    const uint32_t mask = (mKmerLength == 16) ? 0xffffffff : ((1u << (2 * mKmerLength)) - 1);
+    uint32_t kmer = 0;
+    unsigned int numBases = 0;
+
+    for(unsigned int i = 0; i < sequence.length(); i++) {
+	uint32_t base;
+	switch(sequence[i]) {
+	    case 'A': base = 0; break;
+	    case 'C': base = 1; break;
+	    case 'G': base = 2; break;
+	    case 'T': base = 3; break;
+	    default:
+		numBases = 0;
+		continue;
+	}
+	kmer = ((kmer << 2) | base) & mask;
+	if(++numBases >= mKmerLength) kmers.push_back(((uint64_t) kmer << 32) | (i + 1 - mKmerLength));
+    }
+}
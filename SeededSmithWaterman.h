@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include "BandedSmithWaterman.h"
+#include "SmithWatermanGotoh.h"
+
+using namespace std;
+
+// ============================================================================
+// Seed-and-extend front end for the banded Smith-Waterman aligner
+//
+// The k-mers shared by the reference and the query vote for the diagonal
+// (reference position - query position) they lie on. The banded aligner is
+// then run around the diagonal with the most votes, so a near-diagonal pair
+// costs O(n * bandwidth) instead of O(m * n). Where the band runs off the
+// reference, the reference is padded with N. When no diagonal is seeded, or
+// the query is shorter than MIN_QUERY_BANDWIDTHS bands, the pair is aligned
+// with the full Smith-Waterman-Gotoh aligner instead: below that length the
+// banded aligner is slower than the full one.
+//
+// The banded alignment only matches the full one while the optimal path stays
+// in the band. Indels that drift the query more than half the bandwidth off
+// the seeded diagonal can give a different alignment, scoring no better.
+// ============================================================================
+
+class CSeededSmithWaterman {
+public:
+    // constructor, an even bandwidth is widened by one since the band is centered on the diagonal
+    CSeededSmithWaterman(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty, unsigned int bandWidth, unsigned int kmerLength = 11);
+    // aligns the query sequence to the reference, within a band around the seeded diagonal when there is one
+    void Align(unsigned int& referenceAl, string& cigarAl, const string& s1, const string& s2);
+    // finds the diagonal sharing the most k-mers and returns its leftmost shared k-mer as the hash region. Returns false if no diagonal is seeded.
+    bool FindHashRegion(pair< pair<unsigned int, unsigned int>, pair<unsigned int, unsigned int> >& hr, const string& s1, const string& s2);
+    // true if the last alignment was computed by the banded aligner
+    bool IsBanded;
+    // the score of the last alignment, from whichever aligner computed it
+    float BestScore;
+    // the full aligner used when seeding fails, exposed to configure its penalties
+    CSmithWatermanGotoh FullAligner;
+private:
+    // packs the k-mers of the sequence as (k-mer << 32 | position), skipping those with bases other than ACGT
+    void PackKmers(vector<uint64_t>& kmers, const string& sequence) const;
+    // the banded aligner
+    CBandedSmithWaterman mBandedAligner;
+    unsigned int mBandwidth;
+    unsigned int mKmerLength;
+    // reference k-mers, sorted
+    vector<uint64_t> mReferenceKmers;
+    // query k-mers in query order
+    vector<uint64_t> mQueryKmers;
+    // seed hits as (diagonal << 32 | query position)
+    vector<uint64_t> mHits;
+    // the reference padded to hold the band
+    string mPaddedReference;
+    // k-mers seen more often than this in the reference are repeats and cast no votes
+    static const unsigned int MAX_KMER_OCCURRENCES;
+    // a diagonal needs this many votes to be seeded
+    static const unsigned int MIN_SEED_HITS;
+    // queries shorter than this many bandwidths are aligned with the full aligner
+    static const unsigned int MIN_QUERY_BANDWIDTHS;
+};
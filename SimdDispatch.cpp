@@ -0,0 +1,98 @@
+#include "SimdKernels.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+// ============================================================================
+// picks the SIMD fill kernels at first use. This file is compiled with the
+// baseline flags: it must run on every CPU before the choice is made.
+// ============================================================================
+
+#if defined(__SSE2__)
+extern const CSimdKernels Sse2SimdKernels;
+#endif
+
+// the Makefile builds the wider variants on x86-64 only
+#if defined(SIMD_KERNEL_VARIANTS)
+extern const CSimdKernels Sse41SimdKernels;
+extern const CSimdKernels Avx2SimdKernels;
+extern const CSimdKernels Avx512SimdKernels;
+#endif
+
+// a compiled kernel variant and whether the CPU supports it
+struct CSimdVariant {
+    const CSimdKernels* Kernels;
+    bool                IsSupported;
+};
+
+// collects the compiled variants from the narrowest to the widest
+static unsigned int GetSimdVariants(CSimdVariant* variants) {
+
+    unsigned int numVariants = 0;
+
+#if defined(__SSE2__)
+    variants[numVariants].Kernels     = &Sse2SimdKernels;
+    variants[numVariants].IsSupported = true;
+    numVariants++;
+#endif
+
+#if defined(SIMD_KERNEL_VARIANTS)
+    __builtin_cpu_init();
+
+    variants[numVariants].Kernels     = &Sse41SimdKernels;
+    variants[numVariants].IsSupported = __builtin_cpu_supports("sse4.1");
+    numVariants++;
+
+    variants[numVariants].Kernels     = &Avx2SimdKernels;
+    variants[numVariants].IsSupported = __builtin_cpu_supports("avx2");
+    numVariants++;
+
+    variants[numVariants].Kernels     = &Avx512SimdKernels;
+    variants[numVariants].IsSupported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+    numVariants++;
+#endif
+
+    return numVariants;
+}
+
+// returns the widest supported variant, or the one named by SW_SIMD
+static const CSimdKernels* SelectSimdKernels(void) {
+
+    CSimdVariant variants[4];
+    const unsigned int numVariants = GetSimdVariants(variants);
+
+    const char* forced = getenv("SW_SIMD");
+    if(!forced || (forced[0] == 0)) {
+	const CSimdKernels* pKernels = NULL;
+	for(unsigned int v = 0; v < numVariants; v++) {
+	    if(variants[v].IsSupported) pKernels = variants[v].Kernels;
+	}
+	return pKernels;
+    }
+
+    if(strcmp(forced, "scalar") == 0) return NULL;
+
+    for(unsigned int v = 0; v < numVariants; v++) {
+	if(strcmp(forced, variants[v].Kernels->Name) != 0) continue;
+	if(!variants[v].IsSupported) {
+	    cout << "ERROR: SW_SIMD requests the " << forced << " kernels, which this CPU does not support." << endl;
+	    exit(1);
+	}
+	return variants[v].Kernels;
+    }
+
+    cout << "ERROR: SW_SIMD names unknown kernels: " << forced << ". The kernels in this build are: scalar";
+    for(unsigned int v = 0; v < numVariants; v++) cout << " " << variants[v].Kernels->Name;
+    cout << endl;
+    exit(1);
+}
+
+// returns the kernels picked for this CPU, or NULL when the SIMD fills are not available
+const CSimdKernels* GetSimdKernels(void) {
+    static const CSimdKernels* pKernels = SelectSimdKernels();
+    return pKernels;
+}
@@ -0,0 +1,465 @@
+// ============================================================================
+// SIMD fill kernels
+//
+// This file is compiled once per instruction set. The Makefile defines one of
+// SIMD_KERNELS_SSE41, SIMD_KERNELS_AVX2 or SIMD_KERNELS_AVX512 together with
+// the matching -m flags, the plain build gives the SSE2 kernels. Each object
+// exports a single CSimdKernels table, GetSimdKernels picks one at run time.
+// Nothing else may be defined here with external linkage, see SimdVectors.h.
+// ============================================================================
+
+#include <string.h>
+
+#include "SimdKernels.h"
+#include "SimdVectors.h"
+
+#define MOSAIK_NUM_NUCLEOTIDES 26
+
+#if defined(SIMD_KERNELS_AVX512)
+typedef CAvx512FloatVector CKernelFloatVector;
+typedef CAvx512ShortVector CKernelShortVector;
+#define SIMD_KERNELS_TABLE Avx512SimdKernels
+#define SIMD_KERNELS_NAME  "avx512"
+#elif defined(SIMD_KERNELS_AVX2)
+typedef CAvx2FloatVector CKernelFloatVector;
+typedef CAvx2ShortVector CKernelShortVector;
+#define SIMD_KERNELS_TABLE Avx2SimdKernels
+#define SIMD_KERNELS_NAME  "avx2"
+#elif defined(SIMD_KERNELS_SSE41)
+typedef CSse41FloatVector CKernelFloatVector;
+typedef CSse41ShortVector CKernelShortVector;
+#define SIMD_KERNELS_TABLE Sse41SimdKernels
+#define SIMD_KERNELS_NAME  "sse41"
+#elif defined(SIMD_VECTORS)
+typedef CSse2FloatVector CKernelFloatVector;
+typedef CSse2ShortVector CKernelShortVector;
+#define SIMD_KERNELS_TABLE Sse2SimdKernels
+#define SIMD_KERNELS_NAME  "sse2"
+#endif
+
+#if defined(SIMD_KERNELS_TABLE)
+
+// ====================
+// striped fill kernel
+// ====================
+
+template<class V, bool StoreTraceback>
+static void StripedFill(const CStripedFillParameters& p, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn) {
+
+    typedef typename V::Vec   Vec;
+    typedef typename V::Score Score;
+
+    const unsigned int numLanes      = V::LANES;
+    const unsigned int segmentLength = p.SegmentLength;
+    const unsigned int queryLength   = p.QueryLength;
+
+    // carve the workspace into the query profile and the score vectors
+    Vec* pvProfile = (Vec*)p.Workspace;
+    Vec* pvHPrevious = pvProfile + p.NumSymbols * segmentLength;
+    Vec* pvHCurrent  = pvHPrevious + segmentLength;
+    Vec* pvEPrevious = pvHCurrent + segmentLength;
+    Vec* pvECurrent  = pvEPrevious + segmentLength;
+    Vec* pvDiagonal  = pvECurrent + segmentLength;
+    Vec* pvF         = pvDiagonal + segmentLength;
+
+    // build the striped query profile: one row of substitution scores per reference symbol
+    Score* pProfile = (Score*)pvProfile;
+    for(unsigned int k = 0; k < p.NumSymbols; k++) {
+	const int c1 = (char)p.Symbols[k] - 'A';
+	for(unsigned int s = 0; s < segmentLength; s++) {
+	    for(unsigned int l = 0; l < numLanes; l++) {
+		const unsigned int q = l * segmentLength + s;
+		*pProfile++ = (q < queryLength) ? (Score)p.ScoringMatrix[c1 * MOSAIK_NUM_NUCLEOTIDES + (p.Query[q] - 'A')] : V::Padding();
+	    }
+	}
+    }
+
+    const Score negativeInfinity = V::NegativeInfinity();
+    const Score gapOpen          = (Score)p.GapOpenPenalty;
+    const Vec vZero      = V::Set1(0);
+    const Vec vNegInf    = V::Set1(negativeInfinity);
+    const Vec vGapOpen   = V::Set1(gapOpen);
+    const Vec vGapExtend = V::Set1((Score)p.GapExtendPenalty);
+
+    // the gap coming in from column 0 is always a freshly opened one
+    const Score firstGapScore = (Score)(0 - gapOpen);
+
+    if(p.RowState) {
+	memcpy(pvHPrevious, p.RowState, segmentLength * sizeof(Vec));
+	memcpy(pvEPrevious, p.RowState + segmentLength * sizeof(Vec), segmentLength * sizeof(Vec));
+    } else {
+	for(unsigned int s = 0; s < segmentLength; s++) {
+	    pvHPrevious[s] = vZero;
+	    pvEPrevious[s] = vNegInf;
+	}
+    }
+
+    Score best = negativeInfinity;
+    bestRow    = 0;
+    bestColumn = 0;
+
+    for(unsigned int i = p.FirstRow; i <= p.LastRow; i++) {
+
+	const Vec* pvRowProfile = pvProfile + p.SymbolRows[(unsigned char)p.Reference[i - 1]] * segmentLength;
+
+	// main pass: vertical gaps, diagonal and a first estimate of the horizontal gaps
+	Vec vDiagonal = V::ShiftIn(pvHPrevious[segmentLength - 1], 0);
+	Vec vF        = V::ShiftIn(vNegInf, firstGapScore);
+
+	for(unsigned int s = 0; s < segmentLength; s++) {
+	    const Vec vHPrevious = pvHPrevious[s];
+	    const Vec vE = V::Max(V::Sub(pvEPrevious[s], vGapExtend), V::Sub(vHPrevious, vGapOpen));
+	    const Vec vD = V::Add(vDiagonal, pvRowProfile[s]);
+	    vDiagonal = vHPrevious;
+
+	    const Vec vH = V::Max(V::Max(vD, vE), V::Max(vF, vZero));
+	    pvECurrent[s] = vE;
+	    pvDiagonal[s] = vD;
+	    pvHCurrent[s] = vH;
+	    pvF[s]        = vF;
+
+	    vF = V::Max(V::Sub(vF, vGapExtend), V::Sub(vH, vGapOpen));
+	}
+
+	// lazy-F loop: carry the horizontal gaps across the segment boundaries
+	vF = V::ShiftIn(vF, firstGapScore);
+	unsigned int s = 0;
+	while(V::AnyGreater(vF, pvF[s])) {
+	    const Vec vFs = V::Max(pvF[s], vF);
+	    const Vec vH  = V::Max(pvHCurrent[s], vFs);
+	    pvF[s]        = vFs;
+	    pvHCurrent[s] = vH;
+
+	    vF = V::Max(V::Sub(vFs, vGapExtend), V::Sub(vH, vGapOpen));
+	    if(++s == segmentLength) {
+		s  = 0;
+		vF = V::ShiftIn(vF, firstGapScore);
+	    }
+	}
+
+	// traceback pass: directions and gap extension flags
+	Vec vMax = vZero;
+	if(StoreTraceback) {
+	    const unsigned int rowSize = segmentLength * numLanes;
+	    char* pCells = p.CompactTraceback ? p.RowTraceback : p.Traceback + (size_t)(i - p.FirstRow) * rowSize;
+	    Vec vFLeft = V::ShiftIn(pvF[segmentLength - 1], negativeInfinity);
+	    Vec vHLeft = V::ShiftIn(pvHCurrent[segmentLength - 1], 0);
+
+	    for(unsigned int s = 0; s < segmentLength; s++, pCells += numLanes) {
+		const Vec vH = pvHCurrent[s];
+		const Vec vVerticalExtend   = V::CmpGt(V::Sub(pvEPrevious[s], vGapExtend), V::Sub(pvHPrevious[s], vGapOpen));
+		const Vec vHorizontalExtend = V::CmpGt(V::Sub(vFLeft, vGapExtend), V::Sub(vHLeft, vGapOpen));
+		V::StoreTraceback(pCells, vH, pvDiagonal[s], pvECurrent[s], vZero, vVerticalExtend, vHorizontalExtend);
+		vMax   = V::Max(vMax, vH);
+		vFLeft = pvF[s];
+		vHLeft = vH;
+	    }
+
+	    if(p.CompactTraceback) PackTracebackNibbles(p.Traceback + (size_t)(i - p.FirstRow) * rowSize / 2, p.RowTraceback, rowSize);
+	} else {
+	    for(unsigned int s = 0; s < segmentLength; s++) vMax = V::Max(vMax, pvHCurrent[s]);
+	}
+
+	// the best cell is the first one in row-major order with the highest score
+	const Score rowMax = V::HorizontalMax(vMax);
+	if(rowMax > best) {
+	    const Vec vRowMax = V::Set1(rowMax);
+	    unsigned int lanes = 0;
+	    for(unsigned int s = 0; s < segmentLength; s++) lanes |= V::EqualLanes(pvHCurrent[s], vRowMax);
+
+	    unsigned int lane = 0;
+	    while(!(lanes & (1u << lane))) lane++;
+
+	    unsigned int segment = 0;
+	    while(!(V::EqualLanes(pvHCurrent[segment], vRowMax) & (1u << lane))) segment++;
+
+	    best       = rowMax;
+	    bestRow    = i;
+	    bestColumn = lane * segmentLength + segment + 1;
+	}
+
+	Vec* pvSwap = pvHPrevious; pvHPrevious = pvHCurrent; pvHCurrent = pvSwap;
+	pvSwap = pvEPrevious; pvEPrevious = pvECurrent; pvECurrent = pvSwap;
+    }
+
+    // the row state keeps the H vectors followed by the E vectors
+    if(p.RowState) {
+	memcpy(p.RowState, pvHPrevious, segmentLength * sizeof(Vec));
+	memcpy(p.RowState + segmentLength * sizeof(Vec), pvEPrevious, segmentLength * sizeof(Vec));
+    }
+
+    bestScore = (float)best;
+}
+
+// sets the row state to the score vectors of row 0. The row state is not
+// necessarily aligned, so it is only ever accessed through memcpy.
+template<class V>
+static void InitializeStripedRowState(char* pRowState, const unsigned int segmentLength) {
+    typedef typename V::Vec Vec;
+    const Vec vZero   = V::Set1(0);
+    const Vec vNegInf = V::Set1(V::NegativeInfinity());
+    for(unsigned int s = 0; s < segmentLength; s++) {
+	memcpy(pRowState + s * sizeof(Vec), &vZero, sizeof(Vec));
+	memcpy(pRowState + (segmentLength + s) * sizeof(Vec), &vNegInf, sizeof(Vec));
+    }
+}
+
+// ==================
+// batch fill kernel
+// ==================
+
+// the gap penalties of the recurrence as vectors
+template<class V>
+struct CBatchPenalties {
+    typename V::Vec Zero;
+    typename V::Vec GapOpen;
+    typename V::Vec GapExtend;
+};
+
+// computes one cell vector of the Gotoh recurrence and stores its traceback byte per lane
+template<class V>
+static inline typename V::Vec BatchCell(const CBatchPenalties<V>& penalties, const typename V::Vec vHUp, const typename V::Vec vEUp, const typename V::Vec vDiagonal, const typename V::Vec vProfile, typename V::Vec& vHLeft, typename V::Vec& vFLeft, typename V::Vec& vE, char* pCells) {
+
+    typedef typename V::Vec Vec;
+
+    // vertical gaps
+    const Vec vEExtend = V::Sub(vEUp, penalties.GapExtend);
+    const Vec vEOpen   = V::Sub(vHUp, penalties.GapOpen);
+    vE = V::Max(vEExtend, vEOpen);
+
+    // horizontal gaps
+    const Vec vFExtend = V::Sub(vFLeft, penalties.GapExtend);
+    const Vec vFOpen   = V::Sub(vHLeft, penalties.GapOpen);
+    const Vec vF       = V::Max(vFExtend, vFOpen);
+
+    const Vec vD = V::Add(vDiagonal, vProfile);
+    const Vec vH = V::Max(V::Max(vD, vE), V::Max(vF, penalties.Zero));
+
+    V::StoreTraceback(pCells, vH, vD, vE, penalties.Zero, V::CmpGt(vEExtend, vEOpen), V::CmpGt(vFExtend, vFOpen));
+
+    vHLeft = vH;
+    vFLeft = vF;
+    return vH;
+}
+
+// builds the row profile of reference row i by selecting every lane's reference symbol from the query profile
+template<class V>
+static const typename V::Vec* BatchRowProfile(const CBatchFillParameters& p, const unsigned int i, const typename V::Vec* pvQueryProfile, typename V::Vec* pvSymbolMasks, typename V::Vec* pvProfile) {
+
+    typedef typename V::Vec   Vec;
+    typedef typename V::Score Score;
+
+    const unsigned int maxQueryLength = p.MaxQueryLength;
+
+    unsigned int rowSymbols[64];
+    unsigned int numRowSymbols = 0;
+    bool rowSymbolSeen[256];
+    memset(rowSymbolSeen, 0, p.NumSymbols);
+    for(unsigned int l = 0; l < p.NumPairs; l++) {
+	if(i > p.ReferenceLengths[l]) continue;
+	const unsigned int k = p.SymbolRows[(unsigned char)p.References[l][i - 1]];
+	if(!rowSymbolSeen[k]) {
+	    rowSymbolSeen[k]            = true;
+	    rowSymbols[numRowSymbols++] = k;
+	    pvSymbolMasks[k]            = V::Set1(0);
+	}
+	memset((char*)&pvSymbolMasks[k] + l * sizeof(Score), 0xFF, sizeof(Score));
+    }
+
+    // every reference of the batch has ended, the remaining rows are never read back
+    if(numRowSymbols == 0) return pvQueryProfile;
+
+    const Vec* pvSymbolProfile = pvQueryProfile + rowSymbols[0] * maxQueryLength;
+    const Vec vMask = pvSymbolMasks[rowSymbols[0]];
+    for(unsigned int j = 0; j < maxQueryLength; j++) pvProfile[j] = V::And(pvSymbolProfile[j], vMask);
+    for(unsigned int r = 1; r < numRowSymbols; r++) {
+	pvSymbolProfile = pvQueryProfile + rowSymbols[r] * maxQueryLength;
+	const Vec vSymbolMask = pvSymbolMasks[rowSymbols[r]];
+	for(unsigned int j = 0; j < maxQueryLength; j++) pvProfile[j] = V::Or(pvProfile[j], V::And(pvSymbolProfile[j], vSymbolMask));
+    }
+
+    return pvProfile;
+}
+
+// keeps the highest valid score of the current row and the first column holding it
+template<class V>
+static inline void BatchRowMax(const typename V::Vec vH, const typename V::Vec vValid, const typename V::Vec vColumn, typename V::Vec& vRowMax, typename V::Vec& vRowColumn) {
+    // the columns beyond the end of a query score 0 and come after every real column
+    const typename V::Vec vScore = V::And(vH, vValid);
+    vRowColumn = V::Select(V::CmpGt(vScore, vRowMax), vColumn, vRowColumn);
+    vRowMax    = V::Max(vRowMax, vScore);
+}
+
+// updates the best cell of every lane with reference row i
+template<class V>
+static inline void BatchBestCell(const CBatchFillParameters& p, const unsigned int i, const typename V::Vec vRowMax, const typename V::Vec vRowColumn, typename V::Vec* pvMax, typename V::Score* best, unsigned int* bestRows, unsigned int* bestColumns) {
+
+    typedef typename V::Score Score;
+
+    pvMax[0] = vRowMax;
+    pvMax[1] = vRowColumn;
+    const Score* pRowMax    = (const Score*)&pvMax[0];
+    const Score* pRowColumn = (const Score*)&pvMax[1];
+
+    // the best cell is the first one in row-major order with the highest score
+    for(unsigned int l = 0; l < p.NumPairs; l++) {
+	if((i > p.ReferenceLengths[l]) || (pRowMax[l] <= best[l])) continue;
+	best[l]        = pRowMax[l];
+	bestRows[l]    = i;
+	bestColumns[l] = (unsigned int)pRowColumn[l];
+    }
+}
+
+template<class V>
+static void BatchFill(const CBatchFillParameters& p, float* bestScores, unsigned int* bestRows, unsigned int* bestColumns) {
+
+    typedef typename V::Vec   Vec;
+    typedef typename V::Score Score;
+
+    const unsigned int numLanes       = V::LANES;
+    const unsigned int maxQueryLength = p.MaxQueryLength;
+
+    // carve the workspace into the query profile, the row profiles and the score vectors
+    Vec* pvQueryProfile = (Vec*)p.Workspace;
+    Vec* pvProfile      = pvQueryProfile + p.NumSymbols * maxQueryLength;
+    Vec* pvNextProfile  = pvProfile + maxQueryLength;
+    Vec* pvH            = pvNextProfile + maxQueryLength;
+    Vec* pvE            = pvH + maxQueryLength + 1;
+    Vec* pvValid        = pvE + maxQueryLength + 1;
+    Vec* pvSymbolMasks  = pvValid + maxQueryLength + 1;
+    Vec* pvMax          = pvSymbolMasks + p.NumSymbols;
+
+    // build the interleaved query profile: for every reference symbol, the substitution scores of every lane's query
+    Score* pQueryProfile = (Score*)pvQueryProfile;
+    for(unsigned int k = 0; k < p.NumSymbols; k++) {
+	const float* pScores = p.ScoringMatrix + ((char)p.Symbols[k] - 'A') * MOSAIK_NUM_NUCLEOTIDES;
+	for(unsigned int l = 0; l < numLanes; l++) {
+	    const unsigned int queryLength = (l < p.NumPairs) ? p.QueryLengths[l] : 0;
+	    const char* pQuery = (l < p.NumPairs) ? p.Queries[l] : NULL;
+	    Score* pLane = pQueryProfile + k * maxQueryLength * numLanes + l;
+	    for(unsigned int j = 0; j < queryLength; j++) pLane[j * numLanes] = (Score)pScores[pQuery[j] - 'A'];
+	    for(unsigned int j = queryLength; j < maxQueryLength; j++) pLane[j * numLanes] = V::Padding();
+	}
+    }
+
+    CBatchPenalties<V> penalties;
+    penalties.Zero      = V::Set1(0);
+    penalties.GapOpen   = V::Set1((Score)p.GapOpenPenalty);
+    penalties.GapExtend = V::Set1((Score)p.GapExtendPenalty);
+
+    const Score negativeInfinity = V::NegativeInfinity();
+    const Vec vZero   = penalties.Zero;
+    const Vec vNegInf = V::Set1(negativeInfinity);
+    const Vec vOne    = V::Set1(1);
+    const Vec vNoMax  = V::Set1(-1);
+
+    // mask out the columns beyond the end of each query
+    for(unsigned int j = 0; j <= maxQueryLength; j++) {
+	char* pMask = (char*)&pvValid[j];
+	for(unsigned int l = 0; l < numLanes; l++) {
+	    const bool valid = (l < p.NumPairs) && (j > 0) && (j <= p.QueryLengths[l]);
+	    memset(pMask + l * sizeof(Score), valid ? 0xFF : 0, sizeof(Score));
+	}
+	pvH[j]    = vZero;
+	pvE[j]    = vNegInf;
+    }
+
+    Score best[64];
+    for(unsigned int l = 0; l < p.NumPairs; l++) {
+	best[l]        = negativeInfinity;
+	bestRows[l]    = 0;
+	bestColumns[l] = 0;
+    }
+
+    const unsigned int rowSize = maxQueryLength * numLanes;
+    unsigned int i = 1;
+
+    // fill two rows per pass, the second one lagging a column behind, so that
+    // the horizontal dependency chains of both rows overlap
+    for(; i + 1 <= p.MaxReferenceLength; i += 2) {
+
+	const Vec* pvProfileA = BatchRowProfile<V>(p, i, pvQueryProfile, pvSymbolMasks, pvProfile);
+	const Vec* pvProfileB = BatchRowProfile<V>(p, i + 1, pvQueryProfile, pvSymbolMasks, pvNextProfile);
+
+	char* pCellsA = p.Traceback + (i - 1) * rowSize;
+	char* pCellsB = pCellsA + rowSize;
+
+	Vec vDiagonalA = vZero, vHLeftA = vZero, vFLeftA = vNegInf, vEA = vNegInf, vMaxA = vNoMax, vMaxColumnA = vZero;
+	Vec vDiagonalB = vZero, vHLeftB = vZero, vFLeftB = vNegInf, vEB = vNegInf, vMaxB = vNoMax, vMaxColumnB = vZero;
+	Vec vColumn = vOne;
+
+	// the first column of row i
+	Vec vHA = BatchCell<V>(penalties, pvH[1], pvE[1], vDiagonalA, pvProfileA[0], vHLeftA, vFLeftA, vEA, pCellsA);
+	vDiagonalA = pvH[1];
+	BatchRowMax<V>(vHA, pvValid[1], vColumn, vMaxA, vMaxColumnA);
+
+	for(unsigned int j = 2; j <= maxQueryLength; j++) {
+
+	    // row i + 1, column j - 1
+	    const Vec vHB = BatchCell<V>(penalties, vHA, vEA, vDiagonalB, pvProfileB[j - 2], vHLeftB, vFLeftB, vEB, pCellsB + (j - 2) * numLanes);
+	    vDiagonalB = vHA;
+	    BatchRowMax<V>(vHB, pvValid[j - 1], vColumn, vMaxB, vMaxColumnB);
+	    pvH[j - 1] = vHB;
+	    pvE[j - 1] = vEB;
+
+	    // row i, column j
+	    vColumn = V::Add(vColumn, vOne);
+	    const Vec vHUp = pvH[j];
+	    vHA = BatchCell<V>(penalties, vHUp, pvE[j], vDiagonalA, pvProfileA[j - 1], vHLeftA, vFLeftA, vEA, pCellsA + (j - 1) * numLanes);
+	    vDiagonalA = vHUp;
+	    BatchRowMax<V>(vHA, pvValid[j], vColumn, vMaxA, vMaxColumnA);
+	}
+
+	// the last column of row i + 1
+	const Vec vHB = BatchCell<V>(penalties, vHA, vEA, vDiagonalB, pvProfileB[maxQueryLength - 1], vHLeftB, vFLeftB, vEB, pCellsB + (maxQueryLength - 1) * numLanes);
+	BatchRowMax<V>(vHB, pvValid[maxQueryLength], vColumn, vMaxB, vMaxColumnB);
+	pvH[maxQueryLength] = vHB;
+	pvE[maxQueryLength] = vEB;
+
+	BatchBestCell<V>(p, i, vMaxA, vMaxColumnA, pvMax, best, bestRows, bestColumns);
+	BatchBestCell<V>(p, i + 1, vMaxB, vMaxColumnB, pvMax, best, bestRows, bestColumns);
+    }
+
+    // an odd reference length leaves a single row
+    if(i == p.MaxReferenceLength) {
+
+	const Vec* pvProfileA = BatchRowProfile<V>(p, i, pvQueryProfile, pvSymbolMasks, pvProfile);
+	char* pCells = p.Traceback + (i - 1) * rowSize;
+
+	Vec vDiagonal = vZero, vHLeft = vZero, vFLeft = vNegInf, vE = vNegInf, vMax = vNoMax, vMaxColumn = vZero;
+	Vec vColumn = vZero;
+	for(unsigned int j = 1; j <= maxQueryLength; j++) {
+	    vColumn = V::Add(vColumn, vOne);
+	    const Vec vHUp = pvH[j];
+	    const Vec vH = BatchCell<V>(penalties, vHUp, pvE[j], vDiagonal, pvProfileA[j - 1], vHLeft, vFLeft, vE, pCells + (j - 1) * numLanes);
+	    vDiagonal = vHUp;
+	    BatchRowMax<V>(vH, pvValid[j], vColumn, vMax, vMaxColumn);
+	    pvH[j]    = vH;
+	    pvE[j]    = vE;
+	}
+
+	BatchBestCell<V>(p, i, vMax, vMaxColumn, pvMax, best, bestRows, bestColumns);
+    }
+
+    for(unsigned int l = 0; l < p.NumPairs; l++) bestScores[l] = (float)best[l];
+}
+
+// ======================
+// the exported kernels
+// ======================
+
+extern const CSimdKernels SIMD_KERNELS_TABLE;
+
+const CSimdKernels SIMD_KERNELS_TABLE = {
+    SIMD_KERNELS_NAME,
+    CKernelFloatVector::LANES,
+    sizeof(CKernelFloatVector::Vec),
+    CKernelShortVector::LANES,
+    sizeof(CKernelShortVector::Vec),
+    { { StripedFill<CKernelFloatVector, false>, StripedFill<CKernelFloatVector, true> },
+      { StripedFill<CKernelShortVector, false>, StripedFill<CKernelShortVector, true> } },
+    { InitializeStripedRowState<CKernelFloatVector>, InitializeStripedRowState<CKernelShortVector> },
+    { BatchFill<CKernelFloatVector>, BatchFill<CKernelShortVector> },
+};
+
+#endif // SIMD_KERNELS_TABLE
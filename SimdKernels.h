@@ -0,0 +1,76 @@
+#pragma once
+
+// ============================================================================
+// run time dispatch of the SIMD fill kernels
+//
+// The striped and batch fill kernels are compiled once per instruction set
+// (SSE2, SSE4.1, AVX2 and AVX-512BW on x86-64). The first call to
+// GetSimdKernels picks the widest set the CPU supports. Setting SW_SIMD to
+// scalar, sse2, sse41, avx2 or avx512 forces a specific variant instead,
+// scalar disables the SIMD fills altogether.
+// ============================================================================
+
+// per-call input of the striped fill kernel
+struct CStripedFillParameters {
+    const char*  Reference;
+    unsigned int ReferenceLength;
+    // the 1-based reference rows to fill
+    unsigned int FirstRow;
+    unsigned int LastRow;
+    // score vectors of the row above FirstRow, updated to LastRow (a fresh fill when NULL)
+    char*        RowState;
+    const char*  Query;
+    unsigned int QueryLength;
+    const float* ScoringMatrix;
+    float        GapOpenPenalty;
+    float        GapExtendPenalty;
+    // distinct reference symbols and the profile row of every byte value
+    const unsigned char* Symbols;
+    unsigned int         NumSymbols;
+    const unsigned char* SymbolRows;
+    unsigned int SegmentLength;
+    char*        Workspace;
+    char*        Traceback;
+    // when set, every row is written to RowTraceback and stored two cells per byte
+    bool         CompactTraceback;
+    char*        RowTraceback;
+};
+
+// per-call input of the batch fill kernel
+struct CBatchFillParameters {
+    const char* const*  References;
+    const unsigned int* ReferenceLengths;
+    const char* const*  Queries;
+    const unsigned int* QueryLengths;
+    unsigned int   NumPairs;
+    unsigned int   MaxReferenceLength;
+    unsigned int   MaxQueryLength;
+    const float*   ScoringMatrix;
+    float          GapOpenPenalty;
+    float          GapExtendPenalty;
+    // distinct reference symbols of the batch and the profile row of every byte value
+    const unsigned char* Symbols;
+    unsigned int         NumSymbols;
+    const unsigned char* SymbolRows;
+    char*          Workspace;
+    char*          Traceback;
+};
+
+// the fill kernels compiled for one instruction set. The kernel arrays are
+// indexed by [short scores] and, for the striped fill, [store traceback].
+struct CSimdKernels {
+    // the name accepted by SW_SIMD
+    const char*  Name;
+    // lanes and size in bytes of the single precision vectors
+    unsigned int FloatLanes;
+    unsigned int FloatVectorSize;
+    // lanes and size in bytes of the 16-bit vectors
+    unsigned int ShortLanes;
+    unsigned int ShortVectorSize;
+    void (*StripedFill[2][2])(const CStripedFillParameters& p, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn);
+    void (*InitializeStripedRowState[2])(char* pRowState, const unsigned int segmentLength);
+    void (*BatchFill[2])(const CBatchFillParameters& p, float* bestScores, unsigned int* bestRows, unsigned int* bestColumns);
+};
+
+// returns the kernels picked for this CPU, or NULL when the SIMD fills are not available
+const CSimdKernels* GetSimdKernels(void);
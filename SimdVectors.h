@@ -0,0 +1,372 @@
+#pragma once
+
+// ============================================================================
+// vector types shared by the SIMD fill kernels
+//
+// The kernels are compiled once per instruction set (see SimdKernels.cpp), so
+// everything in this header lives in an anonymous namespace: an inline
+// function shared between those objects could otherwise be resolved by the
+// linker to a copy using instructions the CPU does not have.
+// ============================================================================
+
+#include <string.h>
+#include "TracebackMatrix.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#define SIMD_VECTORS 1
+#endif
+
+namespace {
+
+// CSmithWatermanGotoh uses this value for "no gap yet"
+static const float SIMD_FLOAT_NEGATIVE_INFINITY = (float)-1e+30;
+
+// ==================
+// vector definitions
+// ==================
+
+// Each vector type provides the handful of operations used by the SIMD fill
+// kernels. ShiftIn moves every lane up by one (towards the end of the query)
+// and inserts a scalar in lane 0. Select picks a where the mask m is set and b
+// elsewhere. StoreTraceback packs the per-lane traceback decisions into one
+// byte per lane.
+
+#if defined(SIMD_VECTORS)
+
+// 4 single precision lanes
+struct CSse2FloatVector {
+    typedef __m128 Vec;
+    typedef float  Score;
+    enum { LANES = 4 };
+
+    static inline Score NegativeInfinity(void) { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Score Padding(void)          { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Vec Set1(Score s)            { return _mm_set1_ps(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm_sub_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm_max_ps(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm_and_ps(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm_or_ps(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static inline Vec ShiftIn(Vec v, Score s) {
+	return _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), _mm_set_ss(s));
+    }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+    static inline Score HorizontalMax(Vec v) {
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+    }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __m128i stop = _mm_castps_si128(_mm_cmpeq_ps(h, zero));
+	const __m128i diag = _mm_castps_si128(_mm_cmpeq_ps(h, d));
+	const __m128i up   = _mm_castps_si128(_mm_cmpeq_ps(h, e));
+	__m128i t = _mm_set1_epi32(TRACEBACK_LEFT);
+	t = _mm_or_si128(_mm_and_si128(up, _mm_set1_epi32(TRACEBACK_UP)), _mm_andnot_si128(up, t));
+	t = _mm_or_si128(_mm_and_si128(diag, _mm_set1_epi32(TRACEBACK_DIAGONAL)), _mm_andnot_si128(diag, t));
+	t = _mm_andnot_si128(stop, t);
+	t = _mm_or_si128(t, _mm_and_si128(_mm_castps_si128(verticalExtend), _mm_set1_epi32(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm_or_si128(t, _mm_and_si128(_mm_castps_si128(horizontalExtend), _mm_set1_epi32(TRACEBACK_HORIZONTAL_EXTEND)));
+	t = _mm_packs_epi32(t, t);
+	t = _mm_packus_epi16(t, t);
+	const int packed = _mm_cvtsi128_si32(t);
+	memcpy(pCells, &packed, LANES);
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm_cmpgt_ps(a, b); }
+};
+
+// 8 saturating 16-bit lanes
+struct CSse2ShortVector {
+    typedef __m128i Vec;
+    typedef short   Score;
+    enum { LANES = 8 };
+
+    static inline Score NegativeInfinity(void) { return -32768; }
+    static inline Score Padding(void)          { return -16384; }
+    static inline Vec Set1(Score s)            { return _mm_set1_epi16(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm_adds_epi16(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm_subs_epi16(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm_max_epi16(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm_and_si128(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm_or_si128(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+    static inline Vec ShiftIn(Vec v, Score s)  { return _mm_insert_epi16(_mm_slli_si128(v, 2), s, 0); }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) {
+	// keep one bit per 16-bit lane
+	const __m128i eq = _mm_cmpeq_epi16(a, b);
+	return _mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+    }
+    static inline Score HorizontalMax(Vec v) {
+	v = _mm_max_epi16(v, _mm_srli_si128(v, 8));
+	v = _mm_max_epi16(v, _mm_srli_si128(v, 4));
+	v = _mm_max_epi16(v, _mm_srli_si128(v, 2));
+	return (Score)_mm_extract_epi16(v, 0);
+    }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __m128i stop = _mm_cmpeq_epi16(h, zero);
+	const __m128i diag = _mm_cmpeq_epi16(h, d);
+	const __m128i up   = _mm_cmpeq_epi16(h, e);
+	__m128i t = _mm_set1_epi16(TRACEBACK_LEFT);
+	t = _mm_or_si128(_mm_and_si128(up, _mm_set1_epi16(TRACEBACK_UP)), _mm_andnot_si128(up, t));
+	t = _mm_or_si128(_mm_and_si128(diag, _mm_set1_epi16(TRACEBACK_DIAGONAL)), _mm_andnot_si128(diag, t));
+	t = _mm_andnot_si128(stop, t);
+	t = _mm_or_si128(t, _mm_and_si128(verticalExtend, _mm_set1_epi16(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm_or_si128(t, _mm_and_si128(horizontalExtend, _mm_set1_epi16(TRACEBACK_HORIZONTAL_EXTEND)));
+	_mm_storel_epi64((__m128i*)pCells, _mm_packus_epi16(t, t));
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm_cmpgt_epi16(a, b); }
+};
+
+#endif // SIMD_VECTORS
+
+#if defined(__SSE4_1__)
+
+// 4 single precision lanes with SSE4.1 blends
+struct CSse41FloatVector : public CSse2FloatVector {
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm_blendv_ps(b, a, m); }
+};
+
+// 8 saturating 16-bit lanes with SSE4.1 blends and horizontal minimum
+struct CSse41ShortVector : public CSse2ShortVector {
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm_blendv_epi8(b, a, m); }
+    static inline Score HorizontalMax(Vec v) {
+	// flipping the low 15 bits maps the signed order onto the reversed unsigned order
+	const __m128i flip = _mm_set1_epi16(0x7FFF);
+	return (Score)(_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(v, flip))) ^ 0x7FFF);
+    }
+};
+
+#endif // __SSE4_1__
+
+#if defined(__AVX2__)
+
+// 8 single precision lanes
+struct CAvx2FloatVector {
+    typedef __m256 Vec;
+    typedef float  Score;
+    enum { LANES = 8 };
+
+    static inline Score NegativeInfinity(void) { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Score Padding(void)          { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Vec Set1(Score s)            { return _mm256_set1_ps(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm256_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm256_sub_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm256_max_ps(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm256_and_ps(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm256_or_ps(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm256_blendv_ps(b, a, m); }
+    static inline Vec ShiftIn(Vec v, Score s) {
+	const Vec shifted = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6));
+	return _mm256_blend_ps(shifted, _mm256_set1_ps(s), 1);
+    }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+    static inline Score HorizontalMax(Vec v) {
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+    }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __m256i stop = _mm256_castps_si256(_mm256_cmp_ps(h, zero, _CMP_EQ_OQ));
+	const __m256i diag = _mm256_castps_si256(_mm256_cmp_ps(h, d, _CMP_EQ_OQ));
+	const __m256i up   = _mm256_castps_si256(_mm256_cmp_ps(h, e, _CMP_EQ_OQ));
+	__m256i t = _mm256_set1_epi32(TRACEBACK_LEFT);
+	t = _mm256_blendv_epi8(t, _mm256_set1_epi32(TRACEBACK_UP), up);
+	t = _mm256_blendv_epi8(t, _mm256_set1_epi32(TRACEBACK_DIAGONAL), diag);
+	t = _mm256_andnot_si256(stop, t);
+	t = _mm256_or_si256(t, _mm256_and_si256(_mm256_castps_si256(verticalExtend), _mm256_set1_epi32(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm256_or_si256(t, _mm256_and_si256(_mm256_castps_si256(horizontalExtend), _mm256_set1_epi32(TRACEBACK_HORIZONTAL_EXTEND)));
+	t = _mm256_packs_epi32(t, t);
+	t = _mm256_packus_epi16(t, t);
+	t = _mm256_permutevar8x32_epi32(t, _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4));
+	_mm_storel_epi64((__m128i*)pCells, _mm256_castsi256_si128(t));
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+};
+
+// 16 saturating 16-bit lanes
+struct CAvx2ShortVector {
+    typedef __m256i Vec;
+    typedef short   Score;
+    enum { LANES = 16 };
+
+    static inline Score NegativeInfinity(void) { return -32768; }
+    static inline Score Padding(void)          { return -16384; }
+    static inline Vec Set1(Score s)            { return _mm256_set1_epi16(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm256_adds_epi16(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm256_subs_epi16(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm256_max_epi16(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm256_and_si256(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm256_or_si256(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm256_blendv_epi8(b, a, m); }
+    static inline Vec ShiftIn(Vec v, Score s) {
+	// bring the low 128 bits up so that alignr can carry lane 7 into lane 8
+	const __m256i carry = _mm256_permute2x128_si256(v, v, 0x08);
+	return _mm256_insert_epi16(_mm256_alignr_epi8(v, carry, 14), s, 0);
+    }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) {
+	const __m256i eq = _mm256_cmpeq_epi16(a, b);
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(eq, _mm256_setzero_si256()), 0xD8);
+	return _mm256_movemask_epi8(packed) & 0xFFFF;
+    }
+    static inline Score HorizontalMax(Vec v) {
+	__m128i m = _mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+	return (Score)_mm_extract_epi16(m, 0);
+    }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __m256i stop = _mm256_cmpeq_epi16(h, zero);
+	const __m256i diag = _mm256_cmpeq_epi16(h, d);
+	const __m256i up   = _mm256_cmpeq_epi16(h, e);
+	__m256i t = _mm256_set1_epi16(TRACEBACK_LEFT);
+	t = _mm256_blendv_epi8(t, _mm256_set1_epi16(TRACEBACK_UP), up);
+	t = _mm256_blendv_epi8(t, _mm256_set1_epi16(TRACEBACK_DIAGONAL), diag);
+	t = _mm256_andnot_si256(stop, t);
+	t = _mm256_or_si256(t, _mm256_and_si256(verticalExtend, _mm256_set1_epi16(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm256_or_si256(t, _mm256_and_si256(horizontalExtend, _mm256_set1_epi16(TRACEBACK_HORIZONTAL_EXTEND)));
+	t = _mm256_permute4x64_epi64(_mm256_packus_epi16(t, t), 0xD8);
+	_mm_storeu_si128((__m128i*)pCells, _mm256_castsi256_si128(t));
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm256_cmpgt_epi16(a, b); }
+};
+
+#endif // __AVX2__
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__)
+
+// 16 single precision lanes. The comparisons return full vector masks like
+// the narrower types, they are turned into mask registers where needed.
+struct CAvx512FloatVector {
+    typedef __m512 Vec;
+    typedef float  Score;
+    enum { LANES = 16 };
+
+    static inline Score NegativeInfinity(void) { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Score Padding(void)          { return SIMD_FLOAT_NEGATIVE_INFINITY; }
+    static inline Vec Set1(Score s)            { return _mm512_set1_ps(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm512_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm512_sub_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm512_max_ps(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm512_and_ps(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm512_or_ps(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm512_mask_blend_ps(_mm512_movepi32_mask(_mm512_castps_si512(m)), b, a); }
+    static inline Vec ShiftIn(Vec v, Score s) {
+	const Vec shifted = _mm512_permutexvar_ps(_mm512_setr_epi32(15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14), v);
+	return _mm512_mask_blend_ps(1, shifted, _mm512_set1_ps(s));
+    }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static inline Score HorizontalMax(Vec v) { return _mm512_reduce_max_ps(v); }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __mmask16 stop = _mm512_cmp_ps_mask(h, zero, _CMP_EQ_OQ);
+	const __mmask16 diag = _mm512_cmp_ps_mask(h, d, _CMP_EQ_OQ);
+	const __mmask16 up   = _mm512_cmp_ps_mask(h, e, _CMP_EQ_OQ);
+	__m512i t = _mm512_set1_epi32(TRACEBACK_LEFT);
+	t = _mm512_mask_blend_epi32(up, t, _mm512_set1_epi32(TRACEBACK_UP));
+	t = _mm512_mask_blend_epi32(diag, t, _mm512_set1_epi32(TRACEBACK_DIAGONAL));
+	t = _mm512_maskz_mov_epi32(~stop, t);
+	t = _mm512_or_si512(t, _mm512_and_si512(_mm512_castps_si512(verticalExtend), _mm512_set1_epi32(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm512_or_si512(t, _mm512_and_si512(_mm512_castps_si512(horizontalExtend), _mm512_set1_epi32(TRACEBACK_HORIZONTAL_EXTEND)));
+	_mm_storeu_si128((__m128i*)pCells, _mm512_cvtepi32_epi8(t));
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm512_castsi512_ps(_mm512_movm_epi32(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ))); }
+};
+
+// 32 saturating 16-bit lanes
+struct CAvx512ShortVector {
+    typedef __m512i Vec;
+    typedef short   Score;
+    enum { LANES = 32 };
+
+    static inline Score NegativeInfinity(void) { return -32768; }
+    static inline Score Padding(void)          { return -16384; }
+    static inline Vec Set1(Score s)            { return _mm512_set1_epi16(s); }
+    static inline Vec Add(Vec a, Vec b)        { return _mm512_adds_epi16(a, b); }
+    static inline Vec Sub(Vec a, Vec b)        { return _mm512_subs_epi16(a, b); }
+    static inline Vec Max(Vec a, Vec b)        { return _mm512_max_epi16(a, b); }
+    static inline Vec And(Vec a, Vec b)        { return _mm512_and_si512(a, b); }
+    static inline Vec Or(Vec a, Vec b)         { return _mm512_or_si512(a, b); }
+    static inline Vec Select(Vec m, Vec a, Vec b) { return _mm512_mask_blend_epi16(_mm512_movepi16_mask(m), b, a); }
+    static inline Vec ShiftIn(Vec v, Score s) {
+	// lane k takes lane k - 1, lane 0 takes s
+	const __m512i previous = _mm512_set_epi16(30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15,
+						  14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0, 31);
+	return _mm512_mask_blend_epi16(1, _mm512_permutexvar_epi16(previous, v), _mm512_set1_epi16(s));
+    }
+    static inline bool AnyGreater(Vec a, Vec b) { return _mm512_cmpgt_epi16_mask(a, b) != 0; }
+    static inline unsigned int EqualLanes(Vec a, Vec b) { return _mm512_cmpeq_epi16_mask(a, b); }
+    static inline Score HorizontalMax(Vec v) {
+	const __m256i m256 = _mm256_max_epi16(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+	__m128i m = _mm_max_epi16(_mm256_castsi256_si128(m256), _mm256_extracti128_si256(m256, 1));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+	return (Score)_mm_extract_epi16(m, 0);
+    }
+    static inline void StoreTraceback(char* pCells, Vec h, Vec d, Vec e, Vec zero, Vec verticalExtend, Vec horizontalExtend) {
+	const __mmask32 stop = _mm512_cmpeq_epi16_mask(h, zero);
+	const __mmask32 diag = _mm512_cmpeq_epi16_mask(h, d);
+	const __mmask32 up   = _mm512_cmpeq_epi16_mask(h, e);
+	__m512i t = _mm512_set1_epi16(TRACEBACK_LEFT);
+	t = _mm512_mask_blend_epi16(up, t, _mm512_set1_epi16(TRACEBACK_UP));
+	t = _mm512_mask_blend_epi16(diag, t, _mm512_set1_epi16(TRACEBACK_DIAGONAL));
+	t = _mm512_maskz_mov_epi16(~stop, t);
+	t = _mm512_or_si512(t, _mm512_and_si512(verticalExtend, _mm512_set1_epi16(TRACEBACK_VERTICAL_EXTEND)));
+	t = _mm512_or_si512(t, _mm512_and_si512(horizontalExtend, _mm512_set1_epi16(TRACEBACK_HORIZONTAL_EXTEND)));
+	_mm256_storeu_si256((__m256i*)pCells, _mm512_cvtepi16_epi8(t));
+    }
+    static inline Vec CmpGt(Vec a, Vec b) { return _mm512_movm_epi16(_mm512_cmpgt_epi16_mask(a, b)); }
+};
+
+#endif // __AVX512F__ && __AVX512BW__ && __AVX512DQ__
+
+#if defined(SIMD_VECTORS)
+
+// packs an even number of one byte traceback cells into two cells per byte
+inline void PackTracebackNibbles(char* pPacked, const char* pCells, const unsigned int numCells) {
+    const __m128i lowNibble  = _mm_set1_epi16(0x000F);
+    const __m128i highNibble = _mm_set1_epi16(0x00F0);
+    unsigned int c = 0;
+    for(; c + 16 <= numCells; c += 16, pPacked += 8) {
+	// each 16-bit word holds an even cell in its low byte and an odd cell in its high byte
+	const __m128i cells = _mm_loadu_si128((const __m128i*)(pCells + c));
+	const __m128i words = _mm_or_si128(_mm_and_si128(cells, lowNibble), _mm_and_si128(_mm_srli_epi16(cells, 4), highNibble));
+	_mm_storel_epi64((__m128i*)pPacked, _mm_packus_epi16(words, words));
+    }
+    for(; c < numCells; c += 2) *pPacked++ = (pCells[c] & 0x0F) | (pCells[c + 1] << 4);
+}
+
+#endif // SIMD_VECTORS
+
+// returns true if every cell of an alignment with at most maxLength aligned
+// bases can be computed exactly in saturating 16-bit lanes
+inline bool SimdShortScoresFit(const float matchScore, const float mismatchScore, const float gapOpenPenalty, const float gapExtendPenalty, const unsigned int maxLength) {
+
+    const float scores[4] = { matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty };
+    for(unsigned int k = 0; k < 4; k++) {
+	if((scores[k] != (float)(int)scores[k]) || (scores[k] > 1000.0f) || (scores[k] < -1000.0f)) return false;
+    }
+
+    // no cell can score more than a full length run of matches
+    const float bestMatch = (matchScore > mismatchScore) ? matchScore : mismatchScore;
+    const float maxScore  = ((bestMatch > 0.0f) ? bestMatch : 0.0f) * (float)(maxLength + 1);
+    return maxScore < 16384.0f;
+}
+
+} // namespace
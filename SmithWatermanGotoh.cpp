@@ -9,11 +9,15 @@ const char CSmithWatermanGotoh::Directions_UP       = 3;
 
 const int CSmithWatermanGotoh::repeat_size_max      = 12;
 
+// 2^28 cells, about 1.3 GB of full traceback matrices
+const size_t CSmithWatermanGotoh::DEFAULT_MAX_MATRIX_SIZE = 268435456;
+
 CSmithWatermanGotoh::CSmithWatermanGotoh(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty) 
     : mCurrentMatrixSize(0)
     , mCurrentAnchorSize(0)
     , mCurrentQuerySize(0)
-    , mCurrentAQSumSize(0)
+    , mCurrentCompactMatrixSize(0)
+    , mMaxMatrixSize(DEFAULT_MAX_MATRIX_SIZE)
     , mMatchScore(matchScore)
     , mMismatchScore(mismatchScore)
     , mGapOpenPenalty(gapOpenPenalty)
@@ -21,29 +25,184 @@ CSmithWatermanGotoh::CSmithWatermanGotoh(float matchScore, float mismatchScore,
     , mPointers(NULL)
     , mSizesOfVerticalGaps(NULL)
     , mSizesOfHorizontalGaps(NULL)
+    , mCompactPointers(NULL)
+    , mCompactFirstRow(1)
+    , mpReference(NULL)
+    , mpQuery(NULL)
     , mQueryGapScores(NULL)
+    , mQueryGapSizes(NULL)
     , mBestScores(NULL)
-    , mReversedAnchor(NULL)
-    , mReversedQuery(NULL)
+    , mNumMismatches(0)
     , mUseHomoPolymerGapOpenPenalty(false)
+    , mHomoPolymerGapOpenPenalty(0.0f)
     , mUseEntropyGapOpenPenalty(false)
+    , mEntropyGapOpenPenalty(0.0f)
     , mUseRepeatGapExtensionPenalty(false)
+    , mRepeatGapExtensionPenalty(0.0f)
+    , mMaxRepeatGapExtensionPenalty(0.0f)
+    , mUseCompactTraceback(false)
+    , mUseCheckpointTraceback(false)
+    , mSpecializeFill(true)
+    , mUseIntegerScoring(false)
+    , mScoreScale(1.0f)
+    , mStripedAligner(&mScoringMatrix[0][0], matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty)
+    , mBatchAligner(&mScoringMatrix[0][0], matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty)
 {
     CreateScoringMatrix();
+    fill(mProfileRows, mProfileRows + 256, -1);
 }
 
 CSmithWatermanGotoh::~CSmithWatermanGotoh(void) {
     if(mPointers)              delete [] mPointers;
     if(mSizesOfVerticalGaps)   delete [] mSizesOfVerticalGaps;
     if(mSizesOfHorizontalGaps) delete [] mSizesOfHorizontalGaps;
+    if(mCompactPointers)       delete [] mCompactPointers;
     if(mQueryGapScores)        delete [] mQueryGapScores;
+    if(mQueryGapSizes)         delete [] mQueryGapSizes;
     if(mBestScores)            delete [] mBestScores;
-    if(mReversedAnchor)        delete [] mReversedAnchor;
-    if(mReversedQuery)         delete [] mReversedQuery;
+}
+
+// read-only view of the traceback pointers and gap sizes filled in by the scalar recurrence
+struct CFullTracebackMatrix {
+    const char*  Pointers;
+    const short* SizesOfVerticalGaps;
+    const short* SizesOfHorizontalGaps;
+    unsigned int QueryLen;
+
+    CFullTracebackMatrix(const char* pointers, const short* sizesOfVerticalGaps, const short* sizesOfHorizontalGaps, const unsigned int queryLen)
+	: Pointers(pointers)
+	, SizesOfVerticalGaps(sizesOfVerticalGaps)
+	, SizesOfHorizontalGaps(sizesOfHorizontalGaps)
+	, QueryLen(queryLen)
+    {}
+
+    inline char Direction(const unsigned int i, const unsigned int j) const {
+	return Pointers[(size_t)i * QueryLen + j];
+    }
+
+    inline unsigned int VerticalGapLength(const unsigned int i, const unsigned int j) const {
+	return SizesOfVerticalGaps[(size_t)i * QueryLen + j];
+    }
+
+    inline unsigned int HorizontalGapLength(const unsigned int i, const unsigned int j) const {
+	return SizesOfHorizontalGaps[(size_t)i * QueryLen + j];
+    }
+};
+
+// returns true if the SIMD fills can be used for the current scoring options
+bool CSmithWatermanGotoh::UseSimdAlignment(void) const {
+    return CStripedSmithWaterman::IsAvailable() && mStripedAligner.IsSupported()
+	&& !mUseHomoPolymerGapOpenPenalty && !mUseEntropyGapOpenPenalty && !mUseRepeatGapExtensionPenalty;
+}
+
+// returns true if the compact traceback can be used for the current scoring options
+bool CSmithWatermanGotoh::UseCompactTraceback(void) const {
+    // the repeat gap extension penalty changes the gap lengths, so they cannot be rebuilt from the extension flags
+    return mUseCompactTraceback && !mUseRepeatGapExtensionPenalty;
+}
+
+// returns true if the checkpointed traceback can be used for the current scoring options
+bool CSmithWatermanGotoh::UseCheckpointTraceback(void) const {
+    // the blocks are stored with the gap extension flags, see UseCompactTraceback
+    return mUseCheckpointTraceback && !mUseRepeatGapExtensionPenalty;
+}
+
+// returns true if the traceback matrix exceeds the matrix size budget and can be rebuilt block by block
+bool CSmithWatermanGotoh::UseLinearSpaceTraceback(const string& s1, const string& s2) const {
+    // the blocks are stored with the gap extension flags, see UseCompactTraceback
+    return ((size_t)s1.length() * s2.length() > mMaxMatrixSize) && !mUseRepeatGapExtensionPenalty;
+}
+
+// grows the buffer holding the compact traceback matrix
+void CSmithWatermanGotoh::InitializeCompactMatrix(const size_t numCells) {
+
+    const size_t compactMatrixSize = (numCells + 1) / 2;
+    if(compactMatrixSize > mCurrentCompactMatrixSize) {
+
+	mCurrentCompactMatrixSize = compactMatrixSize;
+	if(mCompactPointers) delete [] mCompactPointers;
+
+	try {
+	    mCompactPointers = new char[mCurrentCompactMatrixSize];
+	} catch(bad_alloc) {
+	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
+	    exit(1);
+	}
+    }
 }
 
 // aligns the query sequence to the reference using the Smith Waterman Gotoh algorithm
 void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, const string& s1, const string& s2) {
+    Align(referenceAl, mPackedCigar, s1, s2);
+    formatCIGAR(mPackedCigar, cigarAl);
+}
+
+// aligns the query sequence to the reference and returns the cigar packed as in BAM
+void CSmithWatermanGotoh::Align(unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2) {
+    FillAndTraceback(referenceAl, cigarAl, s1, s2);
+    BestScore = UnscaleScore(BestScore);
+}
+
+// aligns the query sequence to the reference and fills in the coordinates, score, mismatches and cigar of the alignment
+void CSmithWatermanGotoh::Align(CSmithWatermanAlignment& alignment, const string& s1, const string& s2) {
+
+    unsigned int referenceAl = 0;
+    Align(referenceAl, alignment.Cigar, s1, s2);
+
+    // the cigar gives the extent of the alignment and its gaps
+    unsigned int referenceBases = 0;
+    unsigned int gapBases       = 0;
+    unsigned int queryBegin     = 0;
+    unsigned int queryEnd       = s2.length();
+    unsigned int numLeadingClips = 0;
+    const vector<uint32_t>& cigar = alignment.Cigar;
+    for(unsigned int c = 0; c < cigar.size(); c++) {
+	const uint32_t length = cigarLength(cigar[c]);
+	switch(cigarOperation(cigar[c])) {
+	case CIGAR_M:
+	case CIGAR_EQ:
+	case CIGAR_X:
+	case CIGAR_N:
+	    referenceBases += length;
+	    break;
+	case CIGAR_D:
+	    referenceBases += length;
+	    gapBases       += length;
+	    break;
+	case CIGAR_I:
+	    gapBases += length;
+	    break;
+	case CIGAR_S:
+	    if(c == numLeadingClips) {
+		queryBegin += length;
+		numLeadingClips++;
+	    } else queryEnd -= length;
+	    break;
+	}
+    }
+
+    // no base aligned: report the empty alignment rather than positions past each other
+    if(referenceBases == 0) {
+	alignment.Cigar.clear();
+	alignment.Score          = BestScore;
+	alignment.ReferenceBegin = alignment.ReferenceEnd = 0;
+	alignment.QueryBegin     = alignment.QueryEnd     = 0;
+	alignment.NumMismatches  = 0;
+	alignment.EditDistance   = 0;
+	return;
+    }
+
+    alignment.Score          = BestScore;
+    alignment.ReferenceBegin = referenceAl;
+    alignment.ReferenceEnd   = referenceAl + referenceBases - 1;
+    alignment.QueryBegin     = queryBegin;
+    alignment.QueryEnd       = queryEnd - 1;
+    alignment.NumMismatches  = mNumMismatches;
+    alignment.EditDistance   = mNumMismatches + gapBases;
+}
+
+// fills the score matrix and traces back the best alignment, on the scaled scores
+void CSmithWatermanGotoh::FillAndTraceback(unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2) {
 
     if((s1.length() == 0) || (s2.length() == 0)) {
 	cout << "ERROR: Found a read with a zero length." << endl;
@@ -52,14 +211,47 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
 
     unsigned int referenceLen      = s1.length() + 1;
     unsigned int queryLen          = s2.length() + 1;
-    unsigned int sequenceSumLength = s1.length() + s2.length();
+
+    // the checkpointed traceback keeps the scores of every sqrt(n)-th row
+    if(UseCheckpointTraceback()) {
+	if(UseSimdAlignment()) AlignCheckpointed(mStripedAligner, referenceAl, cigarAl, s1, s2);
+	else AlignCheckpointed(*this, referenceAl, cigarAl, s1, s2);
+	return;
+    }
+
+    // alignments beyond the matrix size budget keep only a few rows of scores
+    if(UseLinearSpaceTraceback(s1, s2)) {
+	if(UseSimdAlignment()) AlignLinearSpace(mStripedAligner, referenceAl, cigarAl, s1, s2);
+	else AlignLinearSpace(*this, referenceAl, cigarAl, s1, s2);
+	return;
+    }
+
+    // use the striped SIMD fill when only affine gap penalties are used
+    if(UseSimdAlignment()) {
+	unsigned int BestRow    = 0;
+	unsigned int BestColumn = 0;
+	mStripedAligner.Fill(s1, s2, BestScore, BestRow, BestColumn);
+	Traceback(mStripedAligner.GetTracebackMatrix(), referenceAl, cigarAl, s1, s2, BestRow, BestColumn);
+	return;
+    }
+
+    unsigned int BestColumn = 0;
+    unsigned int BestRow    = 0;
+
+    // the compact traceback stores the direction and gap extension flags of two cells per byte
+    if(UseCompactTraceback()) {
+	InitializeCompactMatrix((size_t)(referenceLen - 1) * (queryLen - 1));
+	FillScores<true>(s1, s2, BestRow, BestColumn);
+	Traceback(GetTracebackMatrix(), referenceAl, cigarAl, s1, s2, BestRow, BestColumn);
+	return;
+    }
 
     // reinitialize our matrices
 
-    if((referenceLen * queryLen) > mCurrentMatrixSize) {
+    if(((size_t)referenceLen * queryLen) > mCurrentMatrixSize) {
 
 	// calculate the new matrix size
-	mCurrentMatrixSize = referenceLen * queryLen;
+	mCurrentMatrixSize = (size_t)referenceLen * queryLen;
 
 	// delete the old arrays
 	if(mPointers)              delete [] mPointers;
@@ -80,84 +272,53 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
     }
 
     // initialize the traceback matrix to STOP
+    // N.B. the gap matrices need no initialization, every cell is written during the fill
     memset((char*)mPointers, 0, SIZEOF_CHAR * queryLen);
-    for(unsigned int i = 1; i < referenceLen; i++) mPointers[i * queryLen] = 0;
+    for(unsigned int i = 1; i < referenceLen; i++) mPointers[(size_t)i * queryLen] = 0;
+
+    FillScores<true>(s1, s2, BestRow, BestColumn);
 
-    // initialize the gap matrices to 1
-    uninitialized_fill(mSizesOfVerticalGaps, mSizesOfVerticalGaps + mCurrentMatrixSize, 1);
-    uninitialized_fill(mSizesOfHorizontalGaps, mSizesOfHorizontalGaps + mCurrentMatrixSize, 1);
+    Traceback(CFullTracebackMatrix(mPointers, mSizesOfVerticalGaps, mSizesOfHorizontalGaps, queryLen), referenceAl, cigarAl, s1, s2, BestRow, BestColumn);
+}
+
+// computes the repeat counts and entropies used by the gap penalties
+void CSmithWatermanGotoh::InitializeGapPenalties(const string& s1, const string& s2) {
 
+    vector<TandemRepeat>& referenceRepeats = mReferenceRepeats;
+    vector<TandemRepeat>& queryRepeats     = mQueryRepeats;
+    vector<float>& referenceEntropies = mReferenceEntropies;
+    vector<float>& queryEntropies     = mQueryEntropies;
+    referenceRepeats.clear();
+    queryRepeats.clear();
+    referenceEntropies.clear();
+    queryEntropies.clear();
 
     // initialize our repeat counts if they are needed
-    vector<map<string, int> > referenceRepeats;
-    vector<map<string, int> > queryRepeats;
-    int queryBeginRepeatBases = 0;
-    int queryEndRepeatBases = 0;
     if (mUseRepeatGapExtensionPenalty) {
-	for (unsigned int i = 0; i < queryLen; ++i)
-	    queryRepeats.push_back(repeatCounts(i, s2, repeat_size_max));
-	for (unsigned int i = 0; i < referenceLen; ++i)
-	    referenceRepeats.push_back(repeatCounts(i, s1, repeat_size_max));
-
-	// keep only the biggest repeat
-	vector<map<string, int> >::iterator q = queryRepeats.begin();
-	for (; q != queryRepeats.end(); ++q) {
-	    map<string, int>::iterator biggest = q->begin();
-	    map<string, int>::iterator z = q->begin();
-	    for (; z != q->end(); ++z)
-		if (z->first.size() > biggest->first.size()) biggest = z;
-	    z = q->begin();
-	    while (z != q->end()) {
-		if (z != biggest)
-		    q->erase(z++);
-		else ++z;
-	    }
-	}
-
-	q = referenceRepeats.begin();
-	for (; q != referenceRepeats.end(); ++q) {
-	    map<string, int>::iterator biggest = q->begin();
-	    map<string, int>::iterator z = q->begin();
-	    for (; z != q->end(); ++z)
-		if (z->first.size() > biggest->first.size()) biggest = z;
-	    z = q->begin();
-	    while (z != q->end()) {
-		if (z != biggest)
-		    q->erase(z++);
-		else ++z;
-	    }
-	}
+	annotateTandemRepeats(s2, repeat_size_max, queryRepeats);
+	annotateTandemRepeats(s1, repeat_size_max, referenceRepeats);
 
 	// remove repeat information from ends of queries
 	// this results in the addition of spurious flanking deletions in repeats
-	map<string, int>& qrend = queryRepeats.at(queryRepeats.size() - 2);
-	if (!qrend.empty()) {
-	    int queryEndRepeatBases = qrend.begin()->first.size() * qrend.begin()->second;
+	const TandemRepeat& qrend = queryRepeats.at(queryRepeats.size() - 2);
+	if (qrend.unitLength) {
+	    int queryEndRepeatBases = qrend.unitLength * qrend.count;
 	    for (int i = 0; i < queryEndRepeatBases; ++i)
-		queryRepeats.at(queryRepeats.size() - 2 - i).clear();
+		queryRepeats.at(queryRepeats.size() - 2 - i).unitLength = 0;
 	}
 
-	map<string, int>& qrbegin = queryRepeats.front();
-	if (!qrbegin.empty()) {
-	    int queryBeginRepeatBases = qrbegin.begin()->first.size() * qrbegin.begin()->second;
+	const TandemRepeat& qrbegin = queryRepeats.front();
+	if (qrbegin.unitLength) {
+	    int queryBeginRepeatBases = qrbegin.unitLength * qrbegin.count;
 	    for (int i = 0; i < queryBeginRepeatBases; ++i)
-		queryRepeats.at(i).clear();
+		queryRepeats.at(i).unitLength = 0;
 	}
 
     }
 
-    int entropyWindowSize = 8;
-    vector<float> referenceEntropies;
-    vector<float> queryEntropies;
     if (mUseEntropyGapOpenPenalty) {
-	for (unsigned int i = 0; i < queryLen; ++i)
-	    queryEntropies.push_back(
-		shannon_H((char*) &s2[max(0, min((int) i - entropyWindowSize / 2, (int) queryLen - entropyWindowSize - 1))],
-			  entropyWindowSize));
-	for (unsigned int i = 0; i < referenceLen; ++i)
-	    referenceEntropies.push_back(
-		shannon_H((char*) &s1[max(0, min((int) i - entropyWindowSize / 2, (int) referenceLen - entropyWindowSize - 1))],
-			  entropyWindowSize));
+	InitializeEntropies(s2, queryEntropies);
+	InitializeEntropies(s1, referenceEntropies);
     }
 
     // normalize entropies
@@ -184,25 +345,121 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
     for (vector<float>::iterator r = referenceEntropies.begin(); r != referenceEntropies.end(); ++r)
 	*r = *r / rsum + rmax;
     */
+}
 
-    //
-    // construct
-    //
+// the number of bases the entropy gap open penalty looks at around every position
+static const int ENTROPY_WINDOW_SIZE = 8;
+
+// the entropy of every composition of a window over A, C, G, N and T. A window
+// holding a A's, c C's, g G's and n N's, the remaining bases being T's, has
+// the index a + 9c + 81g + 729n. The entropy only depends on the composition,
+// so the 495 possible windows cover all 5^8 k-mers. Every entry is computed by
+// shannon_H itself, so lookups are bit-identical to it.
+struct CWindowEntropyTable {
+    enum { BASE = ENTROPY_WINDOW_SIZE + 1, SIZE = BASE * BASE * BASE * BASE };
+    // the index weight of every byte value, T counts as 0
+    int Weights[256];
+    // true for the bytes outside A, C, G, N and T
+    bool Other[256];
+    float Entropies[SIZE];
+
+    CWindowEntropyTable(void) {
+	static const char tokens[] = "ACGN";
+	for(unsigned int b = 0; b < 256; b++) {
+	    Weights[b] = 0;
+	    Other[b]   = true;
+	}
+	Other[(unsigned char)'T'] = false;
+	int weight = 1;
+	for(unsigned int t = 0; t < 4; t++, weight *= BASE) {
+	    Weights[(unsigned char)tokens[t]] = weight;
+	    Other[(unsigned char)tokens[t]]   = false;
+	}
+
+	for(int index = 0; index < SIZE; index++) {
+	    char window[ENTROPY_WINDOW_SIZE];
+	    int numBases = 0;
+	    for(int t = 0, rest = index; t < 4; t++, rest /= BASE) {
+		for(int c = 0; (c < rest % BASE) && (numBases < ENTROPY_WINDOW_SIZE); c++) window[numBases++] = tokens[t];
+	    }
+	    while(numBases < ENTROPY_WINDOW_SIZE) window[numBases++] = 'T';
+	    Entropies[index] = shannon_H_r(window, ENTROPY_WINDOW_SIZE, NULL);
+	}
+    }
+};
+
+// returns the window entropy table, built at first use
+static const CWindowEntropyTable& GetWindowEntropyTable(void) {
+    static const CWindowEntropyTable table;
+    return table;
+}
+
+// computes the entropy of the window around every position of s. Entry i
+// (0 <= i <= s.length()) is the shannon_H entropy of the ENTROPY_WINDOW_SIZE
+// bases starting at max(0, min(i - ENTROPY_WINDOW_SIZE / 2, s.length() - ENTROPY_WINDOW_SIZE)).
+// Consecutive windows start at most one base apart, so the composition index
+// is updated in constant time per position and the entropy is a single table
+// lookup. Windows holding any other symbol are handed to shannon_H itself.
+// A sequence shorter than ENTROPY_WINDOW_SIZE has the entropy of all its bases
+// at every position.
+void CSmithWatermanGotoh::InitializeEntropies(const string& s, vector<float>& entropies) const {
+
+    const int length     = s.length();
+    const int windowSize = ENTROPY_WINDOW_SIZE;
+    entropies.resize(length + 1);
+
+    // a sequence shorter than a window is a single window of its own bases
+    if(length < windowSize) {
+	const float entropy = shannon_H_r(s.data(), length, NULL);
+	for(int i = 0; i <= length; i++) entropies[i] = entropy;
+	return;
+    }
+
+    const CWindowEntropyTable& table = GetWindowEntropyTable();
+
+    int index = 0;
+    int numOther = 0;
+    for(int k = 0; k < windowSize; k++) {
+	const unsigned char c = s[k];
+	index    += table.Weights[c];
+	numOther += table.Other[c];
+    }
+
+    int start = 0;
+    for(int i = 0; i <= length; i++) {
+
+	// slide the window to its start for this position
+	const int windowStart = max(0, min(i - windowSize / 2, length - windowSize));
+	for(; start < windowStart; start++) {
+	    const unsigned char out = s[start];
+	    const unsigned char in  = s[start + windowSize];
+	    index    += table.Weights[in] - table.Weights[out];
+	    numOther += table.Other[in] - table.Other[out];
+	}
+
+	entropies[i] = (numOther > 0) ? shannon_H_r(&s[start], windowSize, NULL) : table.Entropies[index];
+    }
+}
+
+// grows the score vectors to the query length
+void CSmithWatermanGotoh::InitializeScoreVectors(const unsigned int queryLen) {
 
     // reinitialize our query-dependent arrays
-    if(s2.length() > mCurrentQuerySize) {
+    if(queryLen - 1 > mCurrentQuerySize) {
 
 	// calculate the new query array size
-	mCurrentQuerySize = s2.length();
+	mCurrentQuerySize = queryLen - 1;
 
 	// delete the old arrays
 	if(mQueryGapScores) delete [] mQueryGapScores;
+	if(mQueryGapSizes)  delete [] mQueryGapSizes;
 	if(mBestScores)     delete [] mBestScores;
 
 	// initialize the arrays
 	try {
 
 	    mQueryGapScores = new float[mCurrentQuerySize + 1];
+	    mQueryGapSizes  = new short[mCurrentQuerySize + 1];
 	    mBestScores     = new float[mCurrentQuerySize + 1];
 
 	} catch(bad_alloc) {
@@ -210,153 +467,231 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
 	    exit(1);
 	}
     }
+}
 
-    // reinitialize our reference+query-dependent arrays
-    if(sequenceSumLength > mCurrentAQSumSize) {
+// adds the query profile rows of the reference symbols
+//
+// Row c of the profile holds the scores of reference symbol c against the
+// query bases, so the fill streams the substitution scores of a reference row
+// instead of looking every cell up in the scoring matrix. The rows are kept
+// while the query stays the same and are shared by all of its references.
+void CSmithWatermanGotoh::InitializeQueryProfile(const string& s1, const string& s2) {
+
+    if(s2 != mProfileQuery) {
+	mProfileQuery = s2;
+	mQueryProfile.clear();
+	fill(mProfileRows, mProfileRows + 256, -1);
+    }
 
-	// calculate the new reference array size
-	mCurrentAQSumSize = sequenceSumLength;
+    const unsigned int queryLength = s2.length();
+    for(unsigned int i = 0; i < s1.length(); i++) {
+	const unsigned char c = s1[i];
+	if(mProfileRows[c] >= 0) continue;
 
-	// delete the old arrays
-	if(mReversedAnchor) delete [] mReversedAnchor;
-	if(mReversedQuery)  delete [] mReversedQuery;
+	mProfileRows[c] = mQueryProfile.size() / queryLength;
+	for(unsigned int j = 0; j < queryLength; j++) mQueryProfile.push_back(mScoringMatrix[c - 'A'][s2[j] - 'A']);
+    }
+}
 
-	// initialize the arrays
-	try {
+// fills the score vectors row by row and locates the best cell, storing the traceback matrices if requested
+template<bool StoreTraceback>
+void CSmithWatermanGotoh::FillScores(const string& s1, const string& s2, unsigned int& BestRow, unsigned int& BestColumn) {
 
-	    mReversedAnchor = new char[mCurrentAQSumSize + 1];	// reversed sequence #1
-	    mReversedQuery  = new char[mCurrentAQSumSize + 1];	// reversed sequence #2
+    unsigned int queryLen = s2.length() + 1;
 
-	} catch(bad_alloc) {
-	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
-	    exit(1);
-	}
-    }
+    BeginRowFill(s1, s2);
 
     // initialize the gap score and score vectors
     uninitialized_fill(mQueryGapScores, mQueryGapScores + queryLen, FLOAT_NEGATIVE_INFINITY);
+    uninitialized_fill(mQueryGapSizes, mQueryGapSizes + queryLen, 1);
     memset((char*)mBestScores, 0, SIZEOF_FLOAT * queryLen);
 
+    FillScores<StoreTraceback>(s1, s2, 1, s1.length(), StoreTraceback && UseCompactTraceback(), BestScore, BestRow, BestColumn);
+}
+
+// advances the score vectors over the rows firstRow..lastRow and locates the best cell among them, storing the traceback matrices if requested
+template<bool StoreTraceback>
+void CSmithWatermanGotoh::FillScores(const string& s1, const string& s2, const unsigned int firstRow, const unsigned int lastRow, const bool compactTraceback, float& bestScore, unsigned int& BestRow, unsigned int& BestColumn) {
+
+    if(!mSpecializeFill) {
+	FillScoreRows<StoreTraceback, false, false, false, false>(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn);
+	return;
+    }
+
+    // select the fill compiled for the enabled gap penalties
+    const unsigned int penalties = (mUseHomoPolymerGapOpenPenalty ? 1 : 0) | (mUseEntropyGapOpenPenalty ? 2 : 0) | (mUseRepeatGapExtensionPenalty ? 4 : 0);
+    switch(penalties) {
+    case 0: FillScoreRows<StoreTraceback, true, false, false, false>(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 1: FillScoreRows<StoreTraceback, true, true,  false, false>(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 2: FillScoreRows<StoreTraceback, true, false, true,  false>(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 3: FillScoreRows<StoreTraceback, true, true,  true,  false>(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 4: FillScoreRows<StoreTraceback, true, false, false, true >(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 5: FillScoreRows<StoreTraceback, true, true,  false, true >(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    case 6: FillScoreRows<StoreTraceback, true, false, true,  true >(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    default: FillScoreRows<StoreTraceback, true, true,  true,  true >(s1, s2, firstRow, lastRow, compactTraceback, bestScore, BestRow, BestColumn); break;
+    }
+}
+
+// the fill kernel. When Specialized is set the gap penalty options are the
+// template arguments and the disabled ones compile away, otherwise they are
+// tested for every cell.
+template<bool StoreTraceback, bool Specialized, bool HomoPolymer, bool Entropy, bool Repeat>
+void CSmithWatermanGotoh::FillScoreRows(const string& s1, const string& s2, const unsigned int firstRow, const unsigned int lastRow, const bool compactTraceback, float& bestScore, unsigned int& BestRow, unsigned int& BestColumn) {
+
+    unsigned int queryLen = s2.length() + 1;
+
+    const bool useHomoPolymerGapOpenPenalty  = Specialized ? HomoPolymer : mUseHomoPolymerGapOpenPenalty;
+    const bool useEntropyGapOpenPenalty      = Specialized ? Entropy     : mUseEntropyGapOpenPenalty;
+    const bool useRepeatGapExtensionPenalty  = Specialized ? Repeat      : mUseRepeatGapExtensionPenalty;
+
+    // keep the penalties out of memory, the score vectors could alias them
+    const float gapOpenPenalty            = ScaleScore(mGapOpenPenalty);
+    const float gapExtendPenalty          = ScaleScore(mGapExtendPenalty);
+    const float homoPolymerGapOpenPenalty = ScaleScore(mHomoPolymerGapOpenPenalty);
+    const float repeatGapExtensionPenalty = ScaleScore(mRepeatGapExtensionPenalty);
+
+    // the compact traceback is written cell by cell in row-major order, starting at the first row
+    size_t compactIndex = 0;
+    if(compactTraceback) mCompactFirstRow = firstRow;
+
+    const vector<TandemRepeat>& referenceRepeats = mReferenceRepeats;
+    const vector<TandemRepeat>& queryRepeats     = mQueryRepeats;
+    const vector<float>& referenceEntropies = mReferenceEntropies;
+    const vector<float>& queryEntropies     = mQueryEntropies;
+
     float similarityScore, totalSimilarityScore, bestScoreDiagonal;
     float queryGapExtendScore, queryGapOpenScore;
     float referenceGapExtendScore, referenceGapOpenScore, currentAnchorGapScore;
+    int currentAnchorGapSize;
 
-    unsigned int BestColumn = 0;
-    unsigned int BestRow    = 0;
-    BestScore               = FLOAT_NEGATIVE_INFINITY;
+    BestColumn = 0;
+    BestRow    = 0;
+    bestScore  = FLOAT_NEGATIVE_INFINITY;
 
-    for(unsigned int i = 1, k = queryLen; i < referenceLen; i++, k += queryLen) {
+    size_t k = (size_t)firstRow * queryLen;
+    for(unsigned int i = firstRow; i <= lastRow; i++, k += queryLen) {
 
 	currentAnchorGapScore = FLOAT_NEGATIVE_INFINITY;
+	currentAnchorGapSize  = 1;
 	bestScoreDiagonal = mBestScores[0];
 
-	for(unsigned int j = 1, l = k + 1; j < queryLen; j++, l++) {
+	// substitution scores of the reference base against the query bases
+	const float* pProfile = &mQueryProfile[(size_t)mProfileRows[(unsigned char)s1[i - 1]] * (queryLen - 1)];
+
+	size_t l = k + 1;
+	for(unsigned int j = 1; j < queryLen; j++, l++) {
 
 	    // calculate our similarity score
-	    similarityScore = mScoringMatrix[s1[i - 1] - 'A'][s2[j - 1] - 'A'];
+	    similarityScore = pProfile[j - 1];
 
 	    // fill the matrices
 	    totalSimilarityScore = bestScoreDiagonal + similarityScore;
 	    
 	    //cerr << "i: " << i << ", j: " << j << ", totalSimilarityScore: " << totalSimilarityScore << endl;
 
-	    queryGapExtendScore = mQueryGapScores[j] - mGapExtendPenalty;
-	    queryGapOpenScore   = mBestScores[j] - mGapOpenPenalty;
+	    queryGapExtendScore = mQueryGapScores[j] - gapExtendPenalty;
+	    queryGapOpenScore   = mBestScores[j] - gapOpenPenalty;
 	    
 	    // compute the homo-polymer gap score if enabled
-	    if(mUseHomoPolymerGapOpenPenalty)
+	    if(useHomoPolymerGapOpenPenalty)
 		if((j > 1) && (s2[j - 1] == s2[j - 2]))
-		    queryGapOpenScore = mBestScores[j] - mHomoPolymerGapOpenPenalty;
+		    queryGapOpenScore = mBestScores[j] - homoPolymerGapOpenPenalty;
 	    
 	    // compute the entropy gap score if enabled
-	    if (mUseEntropyGapOpenPenalty) {
+	    if (useEntropyGapOpenPenalty) {
 		queryGapOpenScore = 
-		    mBestScores[j] - mGapOpenPenalty 
+		    mBestScores[j] - gapOpenPenalty 
 		    * max(queryEntropies.at(j), referenceEntropies.at(i))
 		    * mEntropyGapOpenPenalty;
 	    }
 
-	    int gaplen = mSizesOfVerticalGaps[l - queryLen] + 1;
+	    int gaplen = mQueryGapSizes[j] + 1;
 
-	    if (mUseRepeatGapExtensionPenalty) {
-		map<string, int>& repeats = queryRepeats[j];
+	    if (useRepeatGapExtensionPenalty) {
+		const TandemRepeat& repeat = queryRepeats[j];
 		// does the sequence which would be inserted or deleted in this gap match the repeat structure which it is embedded in?
-		if (!repeats.empty()) {
+		if (repeat.unitLength) {
 
-		    const pair<string, int>& repeat = *repeats.begin();
-		    int repeatsize = repeat.first.size();
+		    int repeatsize = repeat.unitLength;
 		    if (gaplen != repeatsize && gaplen % repeatsize != 0) {
 			gaplen = gaplen / repeatsize + repeatsize;
 		    }
 
-		    if ((repeat.first.size() * repeat.second) > 3 && gaplen + i < s1.length()) {
-			string gapseq = string(&s1[i], gaplen);
-			if (gapseq == repeat.first || isRepeatUnit(gapseq, repeat.first)) {
+		    if ((repeat.unitLength * repeat.count) > 3 && gaplen + i < s1.length()) {
+			if (isRepeatUnit(&s1[i], gaplen, &s2[repeat.unitOffset], repeat.unitLength)) {
 			    queryGapExtendScore = mQueryGapScores[j]
-				+ mRepeatGapExtensionPenalty / (float) gaplen;
+				+ repeatGapExtensionPenalty / (float) gaplen;
 				//    mMaxRepeatGapExtensionPenalty)
 			} else {
-			    queryGapExtendScore = mQueryGapScores[j] - mGapExtendPenalty;
+			    queryGapExtendScore = mQueryGapScores[j] - gapExtendPenalty;
 			}
 		    }
 		} else {
-		    queryGapExtendScore = mQueryGapScores[j] - mGapExtendPenalty;
+		    queryGapExtendScore = mQueryGapScores[j] - gapExtendPenalty;
 		}
 	    }
 		  
-	    if(queryGapExtendScore > queryGapOpenScore) {
+	    const bool queryGapExtended = (queryGapExtendScore > queryGapOpenScore);
+	    if(queryGapExtended) {
 		mQueryGapScores[j] = queryGapExtendScore;
-		mSizesOfVerticalGaps[l] = gaplen;
-	    } else mQueryGapScores[j] = queryGapOpenScore;
+		mQueryGapSizes[j]  = gaplen;
+	    } else {
+		mQueryGapScores[j] = queryGapOpenScore;
+		mQueryGapSizes[j]  = 1;
+	    }
+	    if(StoreTraceback && !compactTraceback) mSizesOfVerticalGaps[l] = mQueryGapSizes[j];
 	    
-	    referenceGapExtendScore = currentAnchorGapScore - mGapExtendPenalty;
-	    referenceGapOpenScore   = mBestScores[j - 1] - mGapOpenPenalty;
+	    referenceGapExtendScore = currentAnchorGapScore - gapExtendPenalty;
+	    referenceGapOpenScore   = mBestScores[j - 1] - gapOpenPenalty;
 		  
 	    // compute the homo-polymer gap score if enabled
-	    if(mUseHomoPolymerGapOpenPenalty)
+	    if(useHomoPolymerGapOpenPenalty)
 		if((i > 1) && (s1[i - 1] == s1[i - 2]))
-		    referenceGapOpenScore = mBestScores[j - 1] - mHomoPolymerGapOpenPenalty;
+		    referenceGapOpenScore = mBestScores[j - 1] - homoPolymerGapOpenPenalty;
 		  
 	    // compute the entropy gap score if enabled
-	    if (mUseEntropyGapOpenPenalty) {
+	    if (useEntropyGapOpenPenalty) {
 		referenceGapOpenScore = 
-		    mBestScores[j - 1] - mGapOpenPenalty 
+		    mBestScores[j - 1] - gapOpenPenalty 
 		    * max(queryEntropies.at(j), referenceEntropies.at(i))
 		    * mEntropyGapOpenPenalty;
 	    }
 
-	    gaplen = mSizesOfHorizontalGaps[l - 1] + 1;
+	    gaplen = currentAnchorGapSize + 1;
 
-	    if (mUseRepeatGapExtensionPenalty) {
-		map<string, int>& repeats = referenceRepeats[i];
+	    if (useRepeatGapExtensionPenalty) {
+		const TandemRepeat& repeat = referenceRepeats[i];
 		// does the sequence which would be inserted or deleted in this gap match the repeat structure which it is embedded in?
-		if (!repeats.empty()) {
+		if (repeat.unitLength) {
 
-		    const pair<string, int>& repeat = *repeats.begin();
-		    int repeatsize = repeat.first.size();
+		    int repeatsize = repeat.unitLength;
 		    if (gaplen != repeatsize && gaplen % repeatsize != 0) {
 			gaplen = gaplen / repeatsize + repeatsize;
 		    }
 
-		    if ((repeat.first.size() * repeat.second) > 3 && gaplen + j < s2.length()) {
-			string gapseq = string(&s2[j], gaplen);
-			if (gapseq == repeat.first || isRepeatUnit(gapseq, repeat.first)) {
+		    if ((repeat.unitLength * repeat.count) > 3 && gaplen + j < s2.length()) {
+			if (isRepeatUnit(&s2[j], gaplen, &s1[repeat.unitOffset], repeat.unitLength)) {
 			    referenceGapExtendScore = currentAnchorGapScore
-				+ mRepeatGapExtensionPenalty / (float) gaplen;
+				+ repeatGapExtensionPenalty / (float) gaplen;
 				//mMaxRepeatGapExtensionPenalty)
 			} else {
-			    referenceGapExtendScore = currentAnchorGapScore - mGapExtendPenalty;
+			    referenceGapExtendScore = currentAnchorGapScore - gapExtendPenalty;
 			}
 		    }
 		} else {
-		    referenceGapExtendScore = currentAnchorGapScore - mGapExtendPenalty;
+		    referenceGapExtendScore = currentAnchorGapScore - gapExtendPenalty;
 		}
 	    }
 
-	    if(referenceGapExtendScore > referenceGapOpenScore) {
+	    const bool referenceGapExtended = (referenceGapExtendScore > referenceGapOpenScore);
+	    if(referenceGapExtended) {
 		currentAnchorGapScore = referenceGapExtendScore;
-		mSizesOfHorizontalGaps[l] = gaplen;
-	    } else currentAnchorGapScore = referenceGapOpenScore;
+		currentAnchorGapSize  = gaplen;
+	    } else {
+		currentAnchorGapScore = referenceGapOpenScore;
+		currentAnchorGapSize  = 1;
+	    }
+	    if(StoreTraceback && !compactTraceback) mSizesOfHorizontalGaps[l] = currentAnchorGapSize;
 		  
 	    bestScoreDiagonal = mBestScores[j];
 	    mBestScores[j] = MaxFloats(totalSimilarityScore, mQueryGapScores[j], currentAnchorGapScore);
@@ -364,54 +699,345 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
 		  
 	    // determine the traceback direction
 	    // diagonal (445364713) > stop (238960195) > up (214378647) > left (166504495)
-	    if(mBestScores[j] == 0)                         mPointers[l] = Directions_STOP;
-	    else if(mBestScores[j] == totalSimilarityScore) mPointers[l] = Directions_DIAGONAL;
-	    else if(mBestScores[j] == mQueryGapScores[j])   mPointers[l] = Directions_UP;
-	    else                                            mPointers[l] = Directions_LEFT;
+	    if(StoreTraceback) {
+		// later tests take precedence, which lets the compiler use conditional moves
+		const float cellScore = mBestScores[j];
+		char direction = Directions_LEFT;
+		if(cellScore == mQueryGapScores[j])   direction = Directions_UP;
+		if(cellScore == totalSimilarityScore) direction = Directions_DIAGONAL;
+		if(cellScore == 0)                    direction = Directions_STOP;
+
+		if(compactTraceback) {
+		    const char cell = direction
+			| (queryGapExtended     ? TRACEBACK_VERTICAL_EXTEND   : 0)
+			| (referenceGapExtended ? TRACEBACK_HORIZONTAL_EXTEND : 0);
+		    if(compactIndex & 1) mCompactPointers[compactIndex >> 1] |= cell << 4;
+		    else mCompactPointers[compactIndex >> 1] = cell;
+		    compactIndex++;
+		} else mPointers[l] = direction;
+	    }
 		  
 	    // set the traceback start at the current cell i, j and score
-	    if(mBestScores[j] > BestScore) {
+	    if(mBestScores[j] > bestScore) {
 		BestRow    = i;
 		BestColumn = j;
-		BestScore  = mBestScores[j];
+		bestScore  = mBestScores[j];
 	    }
 	}
     }
+}
+
+// computes the best local alignment score without a traceback
+float CSmithWatermanGotoh::Score(const string& s1, const string& s2, unsigned int& referenceEnd, unsigned int& queryEnd) {
+
+    if((s1.length() == 0) || (s2.length() == 0)) {
+	cout << "ERROR: Found a read with a zero length." << endl;
+	exit(1);
+    }
+
+    unsigned int BestRow    = 0;
+    unsigned int BestColumn = 0;
+
+    if(UseSimdAlignment()) mStripedAligner.Score(s1, s2, BestScore, BestRow, BestColumn);
+    else FillScores<false>(s1, s2, BestRow, BestColumn);
+
+    // the best cell is the last aligned base of both sequences
+    referenceEnd = BestRow - 1;
+    queryEnd     = BestColumn - 1;
+
+    BestScore = UnscaleScore(BestScore);
+    return BestScore;
+}
+
+// prepares the scalar fill of s1 against s2 and returns the size in bytes of the score vectors of one row
+unsigned int CSmithWatermanGotoh::BeginRowFill(const string& s1, const string& s2) {
+
+    mpReference = &s1;
+    mpQuery     = &s2;
+
+    InitializeGapPenalties(s1, s2);
+    InitializeScoreVectors(s2.length() + 1);
+    InitializeQueryProfile(s1, s2);
+
+    return (s2.length() + 1) * (2 * SIZEOF_FLOAT + SIZEOF_SHORT);
+}
+
+// sets the row state to the score vectors of row 0
+void CSmithWatermanGotoh::InitializeRowState(char* pRowState) const {
+
+    const unsigned int queryLen = mpQuery->length() + 1;
+
+    // the row state keeps the best scores followed by the vertical gap scores and sizes
+    float* pBestScores    = (float*)pRowState;
+    float* pQueryGapScores = pBestScores + queryLen;
+    short* pQueryGapSizes  = (short*)(pQueryGapScores + queryLen);
+
+    uninitialized_fill(pBestScores, pBestScores + queryLen, 0.0f);
+    uninitialized_fill(pQueryGapScores, pQueryGapScores + queryLen, FLOAT_NEGATIVE_INFINITY);
+    uninitialized_fill(pQueryGapSizes, pQueryGapSizes + queryLen, 1);
+}
+
+// fills the rows firstRow..lastRow starting from and updating the row state, and locates the best cell among them
+void CSmithWatermanGotoh::FillRows(char* pRowState, const unsigned int firstRow, const unsigned int lastRow, const bool storeTraceback, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn) {
+
+    const unsigned int queryLen = mpQuery->length() + 1;
+
+    memcpy((char*)mBestScores,     pRowState,                            SIZEOF_FLOAT * queryLen);
+    memcpy((char*)mQueryGapScores, pRowState + SIZEOF_FLOAT * queryLen,     SIZEOF_FLOAT * queryLen);
+    memcpy((char*)mQueryGapSizes,  pRowState + 2 * SIZEOF_FLOAT * queryLen, SIZEOF_SHORT * queryLen);
+
+    // the rows are stored as a compact traceback matrix
+    if(storeTraceback) {
+	InitializeCompactMatrix((size_t)(lastRow - firstRow + 1) * (queryLen - 1));
+	FillScores<true>(*mpReference, *mpQuery, firstRow, lastRow, true, bestScore, bestRow, bestColumn);
+    } else FillScores<false>(*mpReference, *mpQuery, firstRow, lastRow, false, bestScore, bestRow, bestColumn);
+
+    memcpy(pRowState,                            (char*)mBestScores,     SIZEOF_FLOAT * queryLen);
+    memcpy(pRowState + SIZEOF_FLOAT * queryLen,     (char*)mQueryGapScores, SIZEOF_FLOAT * queryLen);
+    memcpy(pRowState + 2 * SIZEOF_FLOAT * queryLen, (char*)mQueryGapSizes,  SIZEOF_SHORT * queryLen);
+}
+
+// returns a view of the compact traceback matrix written by the last fill
+CPackedTracebackMatrix CSmithWatermanGotoh::GetTracebackMatrix(void) const {
+    CPackedTracebackMatrix matrix;
+    matrix.Cells         = mCompactPointers;
+    matrix.RowStride     = mpQuery->length();
+    matrix.SegmentLength = mpQuery->length();
+    matrix.SegmentStride = 1;
+    matrix.LaneStride    = 0;
+    matrix.TopRow        = mCompactFirstRow - 1;
+    matrix.Compact       = true;
+    return matrix;
+}
+
+// aligns the sequences keeping only O(log n) rows of scores
+//
+// A first pass locates the best cell. The traceback then runs through the rows
+// above it by divide and conquer: the scores of the middle row are computed
+// from the top row, the lower half is traced back first and the upper half
+// only if the traceback has not stopped yet. Once a block of rows fits the
+// matrix size budget its traceback matrix is filled from the scores of its top
+// row, so every cell holds the same pointers as in the full matrix and the
+// alignment and cigar are identical to the ones of the full traceback.
+template<class RowFiller>
+void CSmithWatermanGotoh::AlignLinearSpace(RowFiller& filler, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2) {
+
+    vector<char> rowState(filler.BeginRowFill(s1, s2));
+
+    unsigned int BestRow    = 0;
+    unsigned int BestColumn = 0;
+    filler.InitializeRowState(&rowState[0]);
+    filler.FillRows(&rowState[0], 1, s1.length(), false, BestScore, BestRow, BestColumn);
+
+    // the rows below the best cell are never reached by the traceback
+    CTracebackState state(BestRow, BestColumn, mReversedCigar);
+    filler.InitializeRowState(&rowState[0]);
+    TracebackRows(filler, state, s1, s2, 0, BestRow, rowState);
+
+    FinishTraceback(state, referenceAl, cigarAl, s1, s2, BestColumn);
+}
+
+// aligns the sequences keeping the scores of every sqrt(n)-th row
+//
+// The forward pass saves the score vectors at the checkpoint rows while it
+// locates the best cell. The traceback then refills the block of rows between
+// two checkpoints, follows it up to the upper checkpoint and moves on to the
+// block above, so the matrix is filled about twice in O(sqrt(n) * m) memory.
+template<class RowFiller>
+void CSmithWatermanGotoh::AlignCheckpointed(RowFiller& filler, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2) {
+
+    const unsigned int referenceLength = s1.length();
+    const unsigned int stateSize       = filler.BeginRowFill(s1, s2);
+
+    unsigned int interval = 1;
+    while(interval * interval < referenceLength) interval++;
+    const unsigned int numCheckpoints = (referenceLength - 1) / interval + 1;
+
+    // checkpoint c holds the score vectors of row c * interval
+    vector<char> checkpoints((size_t)numCheckpoints * stateSize);
+    vector<char> rowState(stateSize);
+    filler.InitializeRowState(&rowState[0]);
+
+    unsigned int BestRow    = 0;
+    unsigned int BestColumn = 0;
+    BestScore = FLOAT_NEGATIVE_INFINITY;
+
+    float blockScore;
+    unsigned int blockRow, blockColumn;
+    for(unsigned int c = 0; c < numCheckpoints; c++) {
+	memcpy(&checkpoints[(size_t)c * stateSize], &rowState[0], stateSize);
+	filler.FillRows(&rowState[0], c * interval + 1, min((c + 1) * interval, referenceLength), false, blockScore, blockRow, blockColumn);
+
+	// keep the first best cell in row-major order
+	if(blockScore > BestScore) {
+	    BestScore  = blockScore;
+	    BestRow    = blockRow;
+	    BestColumn = blockColumn;
+	}
+    }
 
-    //
-    // traceback
-    //
+    CTracebackState state(BestRow, BestColumn, mReversedCigar);
+    unsigned int bottomRow = BestRow;
+    while(!state.Done) {
+	const unsigned int c      = (bottomRow - 1) / interval;
+	const unsigned int topRow = c * interval;
+	memcpy(&rowState[0], &checkpoints[(size_t)c * stateSize], stateSize);
+	filler.FillRows(&rowState[0], topRow + 1, bottomRow, true, blockScore, blockRow, blockColumn);
+	TracebackCells(filler.GetTracebackMatrix(), state, s1, s2, topRow);
+	bottomRow = topRow;
+    }
+
+    FinishTraceback(state, referenceAl, cigarAl, s1, s2, BestColumn);
+}
+
+// traces back through the rows topRow+1..bottomRow given the score vectors of topRow
+template<class RowFiller>
+void CSmithWatermanGotoh::TracebackRows(RowFiller& filler, CTracebackState& state, const string& s1, const string& s2, const unsigned int topRow, const unsigned int bottomRow, const vector<char>& topRowState) {
+
+    vector<char> rowState(topRowState);
+    float blockScore;
+    unsigned int blockRow, blockColumn;
+
+    // the block fits the budget: store its traceback matrix and follow it up to the top row
+    if((bottomRow - topRow == 1) || ((size_t)(bottomRow - topRow) * s2.length() <= mMaxMatrixSize)) {
+	filler.FillRows(&rowState[0], topRow + 1, bottomRow, true, blockScore, blockRow, blockColumn);
+	TracebackCells(filler.GetTracebackMatrix(), state, s1, s2, topRow);
+	return;
+    }
+
+    const unsigned int middleRow = topRow + (bottomRow - topRow) / 2;
+    filler.FillRows(&rowState[0], topRow + 1, middleRow, false, blockScore, blockRow, blockColumn);
+
+    TracebackRows(filler, state, s1, s2, middleRow, bottomRow, rowState);
+    if(!state.Done) TracebackRows(filler, state, s1, s2, topRow, middleRow, topRowState);
+}
+
+// orders the pairs of a batch by length so that similar pairs share a fill
+struct CBatchLengthOrder {
+    const vector<string>& References;
+    const vector<string>& Queries;
+
+    CBatchLengthOrder(const vector<string>& references, const vector<string>& queries)
+	: References(references)
+	, Queries(queries)
+    {}
+
+    bool operator()(const unsigned int a, const unsigned int b) const {
+	if(Queries[a].length() != Queries[b].length()) return Queries[a].length() < Queries[b].length();
+	return References[a].length() < References[b].length();
+    }
+};
+
+// aligns every query sequence to its reference, filling several pairs at once when possible
+void CSmithWatermanGotoh::AlignBatch(vector<unsigned int>& referenceAls, vector<string>& cigarAls, vector<float>& bestScores, const vector<string>& references, const vector<string>& queries) {
+
+    if(references.size() != queries.size()) {
+	cout << "ERROR: The batch has a different number of references and queries." << endl;
+	exit(1);
+    }
+
+    const unsigned int numPairs = references.size();
+    referenceAls.resize(numPairs);
+    cigarAls.resize(numPairs);
+    bestScores.resize(numPairs);
+
+    // the batch fill only handles plain affine gap scoring
+    if(!UseSimdAlignment() || !CBatchSmithWaterman::IsAvailable() || !mBatchAligner.IsSupported()) {
+	for(unsigned int k = 0; k < numPairs; k++) {
+	    Align(referenceAls[k], cigarAls[k], references[k], queries[k]);
+	    bestScores[k] = BestScore;
+	}
+	return;
+    }
+
+    vector<unsigned int> order(numPairs);
+    for(unsigned int k = 0; k < numPairs; k++) order[k] = k;
+    stable_sort(order.begin(), order.end(), CBatchLengthOrder(references, queries));
+
+    const unsigned int maxBatchSize = CBatchSmithWaterman::GetMaxBatchSize();
+    vector<const string*> batchReferences(maxBatchSize);
+    vector<const string*> batchQueries(maxBatchSize);
+    vector<float> batchScores(maxBatchSize);
+    vector<unsigned int> batchRows(maxBatchSize);
+    vector<unsigned int> batchColumns(maxBatchSize);
+
+    unsigned int k = 0;
+    while(k < numPairs) {
+	const unsigned int batchSize = min(maxBatchSize, numPairs - k);
+	for(unsigned int l = 0; l < batchSize; l++) {
+	    batchReferences[l] = &references[order[k + l]];
+	    batchQueries[l]    = &queries[order[k + l]];
+	}
 
-    // aligned sequences
-    int gappedAnchorLen  = 0;   // length of sequence #1 after alignment
-    int gappedQueryLen   = 0;   // length of sequence #2 after alignment
-    int numMismatches    = 0;   // the mismatched nucleotide count
+	const unsigned int numFilled = mBatchAligner.Fill(&batchReferences[0], &batchQueries[0], batchSize, &batchScores[0], &batchRows[0], &batchColumns[0]);
+
+	for(unsigned int l = 0; l < numFilled; l++) {
+	    const unsigned int pair = order[k + l];
+	    Traceback(mBatchAligner.GetTracebackMatrix(l), referenceAls[pair], mPackedCigar, references[pair], queries[pair], batchRows[l], batchColumns[l]);
+	    formatCIGAR(mPackedCigar, cigarAls[pair]);
+	    bestScores[pair] = UnscaleScore(batchScores[l]);
+	    BestScore        = bestScores[pair];
+	}
+
+	k += numFilled;
+    }
+}
+
+// traces back from the best cell and creates the cigar
+template<class TracebackMatrix>
+void CSmithWatermanGotoh::Traceback(const TracebackMatrix& matrix, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2, const unsigned int BestRow, const unsigned int BestColumn) {
+
+    CTracebackState state(BestRow, BestColumn, mReversedCigar);
+    TracebackCells(matrix, state, s1, s2, 0);
+    FinishTraceback(state, referenceAl, cigarAl, s1, s2, BestColumn);
+}
+
+// follows the traceback pointers until the stop cell or the top row of the matrix
+template<class TracebackMatrix>
+void CSmithWatermanGotoh::TracebackCells(const TracebackMatrix& matrix, CTracebackState& state, const string& s1, const string& s2, const unsigned int topRow) {
+
+    vector<uint32_t>& reversedCigar = state.ReversedCigar;
+    int numMismatches    = state.NumMismatches;     // the mismatched nucleotide count
 
     char c1, c2;
+    const float mismatchScore = ScaleScore(mMismatchScore);
 
-    int ci = BestRow;
-    int cj = BestColumn;
-    int ck = ci * queryLen;
+    // the alignments that get left-aligned have their gaps slid left as they are traced
+    const bool slideGaps = mUseEntropyGapOpenPenalty || mUseRepeatGapExtensionPenalty;
+
+    int ci = state.Row;
+    int cj = state.Column;
+    const int top = topRow;
 
     // traceback flag
     bool keepProcessing = true;
 
     while(keepProcessing) {
-	//cerr << ci << " " << cj << " " << ck << "  ... " << gappedAnchorLen << " " << gappedQueryLen <<  endl;
+	//cerr << ci << " " << cj << "  ... " << gappedAnchorLen << " " << gappedQueryLen <<  endl;
+
+	// the rows above the top row belong to the next block
+	if((ci == top) && (top > 0)) break;
+
+	// a vertical gap left open by the block below continues in this one
+	const char direction = state.VerticalGapOpen ? Directions_UP : matrix.Direction(ci, cj);
+	state.VerticalGapOpen = false;
 
 	// diagonal (445364713) > stop (238960195) > up (214378647) > left (166504495)
-	switch(mPointers[ck + cj]) {
+	switch(direction) {
 
 	case Directions_DIAGONAL:
 	    c1 = s1[--ci];
 	    c2 = s2[--cj];
-	    ck -= queryLen;
 
-	    mReversedAnchor[gappedAnchorLen++] = c1;
-	    mReversedQuery[gappedQueryLen++]   = c2;
+	    // a match equal to the last base of the gap traced just before it is
+	    // exchanged with that base, which moves the gap one base to the left
+	    if(slideGaps && (c1 == c2) && IsExchangeableWithGap(reversedCigar, s1, s2, ci, cj))
+		extendCigarOperation(reversedCigar[reversedCigar.size() - 2], 1);
+	    else
+		appendCigarOperation(reversedCigar, 1, CIGAR_M);
 
 	    // increment our mismatch counter
-	    if(mScoringMatrix[c1 - 'A'][c2 - 'A'] == mMismatchScore) numMismatches++;	
+	    if(mScoringMatrix[c1 - 'A'][c2 - 'A'] == mismatchScore) numMismatches++;	
 	    break;
 
 	case Directions_STOP:
@@ -419,48 +1045,94 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
 	    break;
 
 	case Directions_UP:
-	    for(unsigned int l = 0, len = mSizesOfVerticalGaps[ck + cj]; l < len; l++) {
-		if (ci <= 0) {
+	    for(unsigned int l = 0, len = matrix.VerticalGapLength(ci, cj); l < len; l++) {
+		if (ci <= top) {
+		    if(top > 0) state.VerticalGapOpen = true;
 		    keepProcessing = false;
 		    break;
 		}
-		mReversedAnchor[gappedAnchorLen++] = s1[--ci];
-		mReversedQuery[gappedQueryLen++]   = GAP;
-		ck -= queryLen;
+		--ci;
+		appendCigarOperation(reversedCigar, 1, CIGAR_D);
 		numMismatches++;
 	    }
 	    break;
 
 	case Directions_LEFT:
-	    for(unsigned int l = 0, len = mSizesOfHorizontalGaps[ck + cj]; l < len; l++) {
+	    for(unsigned int l = 0, len = matrix.HorizontalGapLength(ci, cj); l < len; l++) {
 		if (cj <= 0) {
 		    keepProcessing = false;
 		    break;
 		}
-		mReversedAnchor[gappedAnchorLen++] = GAP;
-		mReversedQuery[gappedQueryLen++]   = s2[--cj];
+		--cj;
+		appendCigarOperation(reversedCigar, 1, CIGAR_I);
 		numMismatches++;
 	    }
 	    break;
 	}
     }
 
-    // define the reference and query sequences
-    mReversedAnchor[gappedAnchorLen] = 0;
-    mReversedQuery[gappedQueryLen]   = 0;
+    state.Row             = ci;
+    state.Column          = cj;
+    state.NumMismatches   = numMismatches;
+    state.Done            = !keepProcessing && !state.VerticalGapOpen;
+}
 
-    // catch sequences with different lengths
-    if(gappedAnchorLen != gappedQueryLen) {
-	cout << "ERROR: The aligned sequences have different lengths after Smith-Waterman-Gotoh algorithm." << endl;
-	exit(1);
+// returns true if the match of s1[ci] and s2[cj] can trade places with the
+// gap the reversed cigar ends in: the gap has matches on its right and its
+// last base equals the matched one
+bool CSmithWatermanGotoh::IsExchangeableWithGap(const vector<uint32_t>& reversedCigar, const string& s1, const string& s2, const int ci, const int cj) const {
+
+    const unsigned int numOperations = reversedCigar.size();
+    if(numOperations < 2 || cigarOperation(reversedCigar[numOperations - 2]) != CIGAR_M) return false;
+
+    const uint32_t gap = reversedCigar[numOperations - 1];
+    switch(cigarOperation(gap)) {
+    case CIGAR_D:
+	return s1[ci] == s1[ci + cigarLength(gap)];
+    case CIGAR_I:
+	return s2[cj] == s2[cj + cigarLength(gap)];
+    default:
+	return false;
+    }
+}
+
+// counts the mismatched bases of the cigar aligning s2 to s1 from referenceBegin on
+unsigned int CSmithWatermanGotoh::CountMismatches(const vector<uint32_t>& cigar, const string& s1, const string& s2, const unsigned int referenceBegin) const {
+
+    const float mismatchScore = ScaleScore(mMismatchScore);
+    unsigned int numMismatches = 0;
+    unsigned int i = referenceBegin;
+    unsigned int j = 0;
+
+    for(unsigned int c = 0; c < cigar.size(); c++) {
+	const uint32_t length = cigarLength(cigar[c]);
+	switch(cigarOperation(cigar[c])) {
+	case CIGAR_M:
+	    for(uint32_t l = 0; l < length; l++, i++, j++) {
+		// bases aligned beyond the end of a sequence are mismatches
+		if((i >= s1.length()) || (j >= s2.length()) || (mScoringMatrix[s1[i] - 'A'][s2[j] - 'A'] == mismatchScore)) numMismatches++;
+	    }
+	    break;
+	case CIGAR_D:
+	case CIGAR_N:
+	    i += length;
+	    break;
+	case CIGAR_I:
+	case CIGAR_S:
+	    j += length;
+	    break;
+	}
     }
 
-    // reverse the strings and assign them to our alignment structure
-    reverse(mReversedAnchor, mReversedAnchor + gappedAnchorLen);
-    reverse(mReversedQuery,  mReversedQuery  + gappedQueryLen);
+    return numMismatches;
+}
+
+// creates the cigar from the traced back operations and left-aligns it if needed
+void CSmithWatermanGotoh::FinishTraceback(const CTracebackState& state, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2, const unsigned int BestColumn) {
 
-    //alignment.Reference = mReversedAnchor;
-    //alignment.Query     = mReversedQuery;
+    const vector<uint32_t>& reversedCigar = state.ReversedCigar;
+    const int ci = state.Row;
+    const int cj = state.Column;
 
     // set the reference endpoints
     //alignment.ReferenceBegin = ci;
@@ -484,74 +1156,55 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
     //alignment.QueryLength = alignment.QueryEnd - alignment.QueryBegin + 1;
     //alignment.NumMismatches  = numMismatches;
 
-    unsigned int alLength = strlen(mReversedAnchor);
-    unsigned int m = 0, d = 0, i = 0;
-    bool dashRegion = false;
-    ostringstream oCigar (ostringstream::out);
+    unsigned int alLength = 0;
     int insertedBases = 0;
+    cigarAl.clear();
 
     if ( cj != 0 ) {
 	if ( cj > 0 ) {
-	    oCigar << cj << 'S';
+	    cigarAl.push_back(packCigarOperation(cj, CIGAR_S));
 	} else { // how do we get negative cj's?
 	    referenceAl -= cj;
 	    alLength += cj;
 	}
     }
-	
-    for ( unsigned int j = 0; j < alLength; j++ ) {
-	// m
-	if ( ( mReversedAnchor[j] != GAP ) && ( mReversedQuery[j] != GAP ) ) {
-	    if ( dashRegion ) {
-		if ( d != 0 ) oCigar << d << 'D';
-		else          { oCigar << i << 'I'; insertedBases += i; }
-	    }
-	    dashRegion = false;
-	    m++;
-	    d = 0;
-	    i = 0;
-	}
-	else {
-	    if ( !dashRegion && m )
-		oCigar << m << 'M';
-	    dashRegion = true;
-	    m = 0;
-	    if ( mReversedAnchor[j] == GAP ) {
-		if ( d != 0 ) oCigar << d << 'D';
-		i++;
-		d = 0;
-	    }
-	    else {
-		if ( i != 0) { oCigar << i << 'I'; insertedBases += i; }
-		d++;
-		i = 0;
-	    }
-	}
+
+    // the operations were traced back from the end of the alignment.
+    // N.B. a trailing insertion does not count towards the inserted bases
+    for ( vector<uint32_t>::const_reverse_iterator c = reversedCigar.rbegin(); c != reversedCigar.rend(); ++c ) {
+	cigarAl.push_back(*c);
+	alLength += cigarLength(*c);
+	if ( cigarOperation(*c) == CIGAR_I && ( c + 1 ) != reversedCigar.rend() ) insertedBases += cigarLength(*c);
     }
-    if      ( m != 0 ) oCigar << m << 'M';
-    else if ( d != 0 ) oCigar << d << 'D';
-    else if ( i != 0 ) oCigar << i << 'I';
 
     if ( BestColumn != s2.length() )
-	oCigar << s2.length() - BestColumn << 'S';
-
-    cigarAl = oCigar.str();
+	cigarAl.push_back(packCigarOperation(s2.length() - BestColumn, CIGAR_S));
 
-    // fix the gap order
-    CorrectHomopolymerGapOrder(alLength, numMismatches);
+    // the traceback counts the gap bases as mismatches
+    mNumMismatches = state.NumMismatches;
+    for ( unsigned int c = 0; c < reversedCigar.size(); c++ ) {
+	if ( cigarOperation(reversedCigar[c]) != CIGAR_M ) mNumMismatches -= cigarLength(reversedCigar[c]);
+    }
 
-    if (mUseEntropyGapOpenPenalty || mUseRepeatGapExtensionPenalty) {
+    // the traceback has slid the gaps left already, which leaves most
+    // alignments normalized: the left-aligner only runs when it could change them
+    const size_t referenceLength = min((size_t) (alLength - insertedBases), s1.length() - referenceAl);
+    if ((mUseEntropyGapOpenPenalty || mUseRepeatGapExtensionPenalty)
+	&& !isNormalized(s2.data(), s2.length(), cigarAl, s1.data() + referenceAl, referenceLength)) {
 	int offset = 0;
-	string oldCigar;
+	// the left-aligner reads the aligned reference in place
 	try {
-	    oldCigar = cigarAl;
-	    stablyLeftAlign(s2, cigarAl, s1.substr(referenceAl, alLength - insertedBases), offset);
+	    mUnalignedCigar.assign(cigarAl.begin(), cigarAl.end());
+	    stablyLeftAlign(s2.data(), s2.length(), cigarAl, s1.data() + referenceAl, referenceLength, offset, mLeftAlignWorkspace);
 	} catch (...) {
 	    cerr << "an exception occurred when left-aligning " << s1 << " " << s2 << endl;
-	    cigarAl = oldCigar; // undo the failed left-realignment attempt
+	    cigarAl.assign(mUnalignedCigar.begin(), mUnalignedCigar.end()); // undo the failed left-realignment attempt
 	    offset = 0;
 	}
 	referenceAl += offset;
+
+	// the realigned bases may pair up differently
+	if (offset != 0 || cigarAl != mUnalignedCigar) mNumMismatches = CountMismatches(cigarAl, s1, s2, referenceAl);
     }
 
 }
@@ -559,6 +1212,9 @@ void CSmithWatermanGotoh::Align(unsigned int& referenceAl, string& cigarAl, cons
 // creates a simple scoring matrix to align the nucleotides and the ambiguity code N
 void CSmithWatermanGotoh::CreateScoringMatrix(void) {
 
+    const float matchScore    = ScaleScore(mMatchScore);
+    const float mismatchScore = ScaleScore(mMismatchScore);
+
     unsigned int nIndex = 13;
     unsigned int xIndex = 23;
 
@@ -573,77 +1229,142 @@ void CSmithWatermanGotoh::CreateScoringMatrix(void) {
 	    // bad alignments, lets make N be a mismatch instead.
 
 	    // add the matches or mismatches to the hashtable (N is a mismatch)
-	    if((i == nIndex) || (j == nIndex)) mScoringMatrix[i][j] = mMismatchScore;
-	    else if((i == xIndex) || (j == xIndex)) mScoringMatrix[i][j] = mMismatchScore;
-	    else if(i == j) mScoringMatrix[i][j] = mMatchScore;
-	    else mScoringMatrix[i][j] = mMismatchScore;
+	    if((i == nIndex) || (j == nIndex)) mScoringMatrix[i][j] = mismatchScore;
+	    else if((i == xIndex) || (j == xIndex)) mScoringMatrix[i][j] = mismatchScore;
+	    else if(i == j) mScoringMatrix[i][j] = matchScore;
+	    else mScoringMatrix[i][j] = mismatchScore;
 	}
     }
 
     // add ambiguity codes
-    mScoringMatrix['M' - 'A']['A' - 'A'] = mMatchScore;	// M - A
-    mScoringMatrix['A' - 'A']['M' - 'A'] = mMatchScore;
-    mScoringMatrix['M' - 'A']['C' - 'A'] = mMatchScore; // M - C
-    mScoringMatrix['C' - 'A']['M' - 'A'] = mMatchScore;
-
-    mScoringMatrix['R' - 'A']['A' - 'A'] = mMatchScore;	// R - A
-    mScoringMatrix['A' - 'A']['R' - 'A'] = mMatchScore;
-    mScoringMatrix['R' - 'A']['G' - 'A'] = mMatchScore; // R - G
-    mScoringMatrix['G' - 'A']['R' - 'A'] = mMatchScore;
-
-    mScoringMatrix['W' - 'A']['A' - 'A'] = mMatchScore;	// W - A
-    mScoringMatrix['A' - 'A']['W' - 'A'] = mMatchScore;
-    mScoringMatrix['W' - 'A']['T' - 'A'] = mMatchScore; // W - T
-    mScoringMatrix['T' - 'A']['W' - 'A'] = mMatchScore;
-
-    mScoringMatrix['S' - 'A']['C' - 'A'] = mMatchScore;	// S - C
-    mScoringMatrix['C' - 'A']['S' - 'A'] = mMatchScore;
-    mScoringMatrix['S' - 'A']['G' - 'A'] = mMatchScore; // S - G
-    mScoringMatrix['G' - 'A']['S' - 'A'] = mMatchScore;
-
-    mScoringMatrix['Y' - 'A']['C' - 'A'] = mMatchScore;	// Y - C
-    mScoringMatrix['C' - 'A']['Y' - 'A'] = mMatchScore;
-    mScoringMatrix['Y' - 'A']['T' - 'A'] = mMatchScore; // Y - T
-    mScoringMatrix['T' - 'A']['Y' - 'A'] = mMatchScore;
-
-    mScoringMatrix['K' - 'A']['G' - 'A'] = mMatchScore;	// K - G
-    mScoringMatrix['G' - 'A']['K' - 'A'] = mMatchScore;
-    mScoringMatrix['K' - 'A']['T' - 'A'] = mMatchScore; // K - T
-    mScoringMatrix['T' - 'A']['K' - 'A'] = mMatchScore;
-
-    mScoringMatrix['V' - 'A']['A' - 'A'] = mMatchScore;	// V - A
-    mScoringMatrix['A' - 'A']['V' - 'A'] = mMatchScore;
-    mScoringMatrix['V' - 'A']['C' - 'A'] = mMatchScore; // V - C
-    mScoringMatrix['C' - 'A']['V' - 'A'] = mMatchScore;
-    mScoringMatrix['V' - 'A']['G' - 'A'] = mMatchScore; // V - G
-    mScoringMatrix['G' - 'A']['V' - 'A'] = mMatchScore;
-
-    mScoringMatrix['H' - 'A']['A' - 'A'] = mMatchScore;	// H - A
-    mScoringMatrix['A' - 'A']['H' - 'A'] = mMatchScore;
-    mScoringMatrix['H' - 'A']['C' - 'A'] = mMatchScore; // H - C
-    mScoringMatrix['C' - 'A']['H' - 'A'] = mMatchScore;
-    mScoringMatrix['H' - 'A']['T' - 'A'] = mMatchScore; // H - T
-    mScoringMatrix['T' - 'A']['H' - 'A'] = mMatchScore;
-
-    mScoringMatrix['D' - 'A']['A' - 'A'] = mMatchScore;	// D - A
-    mScoringMatrix['A' - 'A']['D' - 'A'] = mMatchScore;
-    mScoringMatrix['D' - 'A']['G' - 'A'] = mMatchScore; // D - G
-    mScoringMatrix['G' - 'A']['D' - 'A'] = mMatchScore;
-    mScoringMatrix['D' - 'A']['T' - 'A'] = mMatchScore; // D - T
-    mScoringMatrix['T' - 'A']['D' - 'A'] = mMatchScore;
-
-    mScoringMatrix['B' - 'A']['C' - 'A'] = mMatchScore;	// B - C
-    mScoringMatrix['C' - 'A']['B' - 'A'] = mMatchScore;
-    mScoringMatrix['B' - 'A']['G' - 'A'] = mMatchScore; // B - G
-    mScoringMatrix['G' - 'A']['B' - 'A'] = mMatchScore;
-    mScoringMatrix['B' - 'A']['T' - 'A'] = mMatchScore; // B - T
-    mScoringMatrix['T' - 'A']['B' - 'A'] = mMatchScore;
+    mScoringMatrix['M' - 'A']['A' - 'A'] = matchScore;	// M - A
+    mScoringMatrix['A' - 'A']['M' - 'A'] = matchScore;
+    mScoringMatrix['M' - 'A']['C' - 'A'] = matchScore; // M - C
+    mScoringMatrix['C' - 'A']['M' - 'A'] = matchScore;
+
+    mScoringMatrix['R' - 'A']['A' - 'A'] = matchScore;	// R - A
+    mScoringMatrix['A' - 'A']['R' - 'A'] = matchScore;
+    mScoringMatrix['R' - 'A']['G' - 'A'] = matchScore; // R - G
+    mScoringMatrix['G' - 'A']['R' - 'A'] = matchScore;
+
+    mScoringMatrix['W' - 'A']['A' - 'A'] = matchScore;	// W - A
+    mScoringMatrix['A' - 'A']['W' - 'A'] = matchScore;
+    mScoringMatrix['W' - 'A']['T' - 'A'] = matchScore; // W - T
+    mScoringMatrix['T' - 'A']['W' - 'A'] = matchScore;
+
+    mScoringMatrix['S' - 'A']['C' - 'A'] = matchScore;	// S - C
+    mScoringMatrix['C' - 'A']['S' - 'A'] = matchScore;
+    mScoringMatrix['S' - 'A']['G' - 'A'] = matchScore; // S - G
+    mScoringMatrix['G' - 'A']['S' - 'A'] = matchScore;
+
+    mScoringMatrix['Y' - 'A']['C' - 'A'] = matchScore;	// Y - C
+    mScoringMatrix['C' - 'A']['Y' - 'A'] = matchScore;
+    mScoringMatrix['Y' - 'A']['T' - 'A'] = matchScore; // Y - T
+    mScoringMatrix['T' - 'A']['Y' - 'A'] = matchScore;
+
+    mScoringMatrix['K' - 'A']['G' - 'A'] = matchScore;	// K - G
+    mScoringMatrix['G' - 'A']['K' - 'A'] = matchScore;
+    mScoringMatrix['K' - 'A']['T' - 'A'] = matchScore; // K - T
+    mScoringMatrix['T' - 'A']['K' - 'A'] = matchScore;
+
+    mScoringMatrix['V' - 'A']['A' - 'A'] = matchScore;	// V - A
+    mScoringMatrix['A' - 'A']['V' - 'A'] = matchScore;
+    mScoringMatrix['V' - 'A']['C' - 'A'] = matchScore; // V - C
+    mScoringMatrix['C' - 'A']['V' - 'A'] = matchScore;
+    mScoringMatrix['V' - 'A']['G' - 'A'] = matchScore; // V - G
+    mScoringMatrix['G' - 'A']['V' - 'A'] = matchScore;
+
+    mScoringMatrix['H' - 'A']['A' - 'A'] = matchScore;	// H - A
+    mScoringMatrix['A' - 'A']['H' - 'A'] = matchScore;
+    mScoringMatrix['H' - 'A']['C' - 'A'] = matchScore; // H - C
+    mScoringMatrix['C' - 'A']['H' - 'A'] = matchScore;
+    mScoringMatrix['H' - 'A']['T' - 'A'] = matchScore; // H - T
+    mScoringMatrix['T' - 'A']['H' - 'A'] = matchScore;
+
+    mScoringMatrix['D' - 'A']['A' - 'A'] = matchScore;	// D - A
+    mScoringMatrix['A' - 'A']['D' - 'A'] = matchScore;
+    mScoringMatrix['D' - 'A']['G' - 'A'] = matchScore; // D - G
+    mScoringMatrix['G' - 'A']['D' - 'A'] = matchScore;
+    mScoringMatrix['D' - 'A']['T' - 'A'] = matchScore; // D - T
+    mScoringMatrix['T' - 'A']['D' - 'A'] = matchScore;
+
+    mScoringMatrix['B' - 'A']['C' - 'A'] = matchScore;	// B - C
+    mScoringMatrix['C' - 'A']['B' - 'A'] = matchScore;
+    mScoringMatrix['B' - 'A']['G' - 'A'] = matchScore; // B - G
+    mScoringMatrix['G' - 'A']['B' - 'A'] = matchScore;
+    mScoringMatrix['B' - 'A']['T' - 'A'] = matchScore; // B - T
+    mScoringMatrix['T' - 'A']['B' - 'A'] = matchScore;
+}
+
+// picks the integer scale of the scoring parameters and rebuilds the scores
+//
+// The scale is the smallest of 1, 10, 100 and 1000 that turns the match and
+// mismatch scores and the gap penalties into integers which divide back to
+// exactly the same float values. All cell scores are then sums of integers,
+// computed exactly as long as they stay below 2^24, so that ties in the
+// traceback no longer depend on rounding. Integral parameter sets keep the
+// scale 1 and their alignments are unchanged. The entropy and repeat penalties
+// scale their gap scores by fractional factors and remain approximate.
+bool CSmithWatermanGotoh::UpdateScoreScale(void) {
+
+    vector<float> parameters;
+    parameters.push_back(mMatchScore);
+    parameters.push_back(mMismatchScore);
+    parameters.push_back(mGapOpenPenalty);
+    parameters.push_back(mGapExtendPenalty);
+    if(mUseHomoPolymerGapOpenPenalty) parameters.push_back(mHomoPolymerGapOpenPenalty);
+
+    float scale = 0.0f;
+    for(float candidate = 1.0f; (scale == 0.0f) && (candidate <= 1000.0f); candidate *= 10.0f) {
+	bool exact = true;
+	for(unsigned int p = 0; p < parameters.size(); p++) {
+	    const double scaled = floor((double)parameters[p] * candidate + 0.5);
+	    if((float)(scaled / candidate) != parameters[p]) exact = false;
+	}
+	if(exact) scale = candidate;
+    }
+
+    const bool found = (scale != 0.0f);
+    if(!found) scale = 1.0f;
+
+    if(scale != mScoreScale) {
+	mScoreScale = scale;
+	CreateScoringMatrix();
+	mStripedAligner.SetScores(ScaleScore(mMatchScore), ScaleScore(mMismatchScore), ScaleScore(mGapOpenPenalty), ScaleScore(mGapExtendPenalty));
+	mBatchAligner.SetScores(ScaleScore(mMatchScore), ScaleScore(mMismatchScore), ScaleScore(mGapOpenPenalty), ScaleScore(mGapExtendPenalty));
+
+	// the query profile holds the old scores
+	mProfileQuery.clear();
+	mQueryProfile.clear();
+	fill(mProfileRows, mProfileRows + 256, -1);
+    }
+
+    return found;
+}
+
+// returns the scoring parameter on the integer scale
+float CSmithWatermanGotoh::ScaleScore(const float score) const {
+    if(mScoreScale == 1.0f) return score;
+    return (float)floor((double)score * mScoreScale + 0.5);
+}
+
+// returns the score on the scale of the scoring parameters
+float CSmithWatermanGotoh::UnscaleScore(const float score) const {
+    if(mScoreScale == 1.0f) return score;
+    return score / mScoreScale;
+}
+
+// enables the integer scoring
+bool CSmithWatermanGotoh::EnableIntegerScoring(void) {
+    mUseIntegerScoring = true;
+    return UpdateScoreScale();
 }
 
 // enables homo-polymer scoring
 void CSmithWatermanGotoh::EnableHomoPolymerGapPenalty(float hpGapOpenPenalty) {
     mUseHomoPolymerGapOpenPenalty = true;
     mHomoPolymerGapOpenPenalty    = hpGapOpenPenalty;
+    if(mUseIntegerScoring) UpdateScoreScale();
 }
 
 // enables entropy-based gap open penalty
@@ -659,83 +1380,23 @@ void CSmithWatermanGotoh::EnableRepeatGapExtensionPenalty(float rGapExtensionPen
     mMaxRepeatGapExtensionPenalty = rMaxGapRepeatExtensionPenaltyFactor * rGapExtensionPenalty;
 }
 
-// corrects the homopolymer gap order for forward alignments
-void CSmithWatermanGotoh::CorrectHomopolymerGapOrder(const unsigned int numBases, const unsigned int numMismatches) {
-
-    // this is only required for alignments with mismatches
-    //if(al.NumMismatches == 0) return;
-    if ( numMismatches == 0 ) return;
-
-    // localize the alignment data
-    //char* pReference = al.Reference.Data();
-    //char* pQuery     = al.Query.Data();
-    //const unsigned int numBases = al.Reference.Length();
-    char* pReference = mReversedAnchor;
-    char* pQuery     = mReversedQuery;
-
-    // initialize
-    bool hasReferenceGap = false, hasQueryGap = false;
-    char* pNonGapSeq = NULL;
-    char* pGapSeq    = NULL;
-    char nonGapBase  = 'J';
-
-    // identify gapped regions
-    for(unsigned int i = 0; i < numBases; i++) {
-
-	// check if the current position is gapped
-	hasReferenceGap = false;
-	hasQueryGap     = false;
-
-	if(pReference[i] == GAP) {
-	    hasReferenceGap = true;
-	    pNonGapSeq      = pQuery;
-	    pGapSeq         = pReference;
-	    nonGapBase      = pQuery[i];
-	}
-
-	if(pQuery[i] == GAP) {
-	    hasQueryGap = true;
-	    pNonGapSeq  = pReference;
-	    pGapSeq     = pQuery;
-	    nonGapBase  = pReference[i];
-	}
-
-	// continue if we don't have any gaps
-	if(!hasReferenceGap && !hasQueryGap) continue;
-
-	// sanity check
-	if(hasReferenceGap && hasQueryGap) {
-	    printf("ERROR: Found a gap in both the reference sequence and query sequence.\n");
-	    exit(1);
-	}
-
-	// find the non-gapped length (forward)
-	unsigned short numGappedBases = 0;
-	unsigned short nonGapLength   = 0;
-	unsigned short testPos = i;
-	while(testPos < numBases) {
-
-	    const char gs  = pGapSeq[testPos];
-	    const char ngs = pNonGapSeq[testPos];
-
-	    bool isPartofHomopolymer = false;
-	    if(((gs == nonGapBase) || (gs == GAP)) && (ngs == nonGapBase)) isPartofHomopolymer = true;
-	    if(!isPartofHomopolymer) break;
+// enables the half byte per cell traceback matrix
+void CSmithWatermanGotoh::EnableCompactTraceback(void) {
+    mUseCompactTraceback = true;
+    mStripedAligner.EnableCompactTraceback();
+}
 
-	    if(gs == GAP) numGappedBases++;
-	    else nonGapLength++;
-	    testPos++;
-	}
+// makes the scalar fill test the gap penalty options in every cell
+void CSmithWatermanGotoh::DisableFillSpecialization(void) {
+    mSpecializeFill = false;
+}
 
-	// fix the gap order
-	if(numGappedBases != 0) {
-	    char* pCurrentSequence = pGapSeq + i;
-	    memset(pCurrentSequence, nonGapBase, nonGapLength);
-	    pCurrentSequence += nonGapLength;
-	    memset(pCurrentSequence, GAP, numGappedBases);
-	}
+// enables the checkpointed traceback
+void CSmithWatermanGotoh::EnableCheckpointTraceback(void) {
+    mUseCheckpointTraceback = true;
+}
 
-	// increment
-	i += numGappedBases + nonGapLength - 1;
-    }
+// sets the largest number of cells for which the whole traceback matrix is stored
+void CSmithWatermanGotoh::SetMaxMatrixSize(size_t maxMatrixSize) {
+    mMaxMatrixSize = maxMatrixSize;
 }
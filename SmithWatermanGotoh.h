@@ -5,19 +5,64 @@
 #include <memory>
 //#include "Alignment.h"
 #include "Mosaik.h"
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "disorder.h"
 #include "Repeats.h"
 #include "LeftAlign.h"
+#include "StripedSmithWaterman.h"
+#include "BatchSmithWaterman.h"
 
 using namespace std;
 
 #define MOSAIK_NUM_NUCLEOTIDES 26
 #define GAP '-'
 
+// position and progress of a traceback, carried from one block of rows to the next
+struct CTracebackState {
+    int Row;
+    int Column;
+    int NumMismatches;
+    // the cigar operations from the best cell back to the current one
+    vector<uint32_t>& ReversedCigar;
+    // a vertical gap runs on into the block above
+    bool VerticalGapOpen;
+    bool Done;
+
+    CTracebackState(const unsigned int row, const unsigned int column, vector<uint32_t>& reversedCigar)
+	: Row(row)
+	, Column(column)
+	, NumMismatches(0)
+	, ReversedCigar(reversedCigar)
+	, VerticalGapOpen(false)
+	, Done(false)
+    {
+	ReversedCigar.clear();
+    }
+};
+
+// the best local alignment of a query to a reference. Callers keep one object
+// and pass it to every Align call, the cigar keeps its capacity.
+struct CSmithWatermanAlignment {
+    // the best local alignment score
+    float Score;
+    // 0-based positions of the first and the last aligned base
+    unsigned int ReferenceBegin;
+    unsigned int ReferenceEnd;
+    unsigned int QueryBegin;
+    unsigned int QueryEnd;
+    // mismatched aligned bases, and the mismatches plus the inserted and deleted bases
+    unsigned int NumMismatches;
+    unsigned int EditDistance;
+    // the cigar packed as in BAM, including the soft clips of the query
+    vector<uint32_t> Cigar;
+    // when no base aligns (score 0) the cigar is empty and every position and count is 0
+};
+
 class CSmithWatermanGotoh {
 public:
     // constructor
@@ -26,28 +71,108 @@ public:
     ~CSmithWatermanGotoh(void);
     // aligns the query sequence to the reference using the Smith Waterman Gotoh algorithm
     void Align(unsigned int& referenceAl, string& cigarAl, const string& s1, const string& s2);
+    // aligns the query sequence to the reference and returns the cigar packed as in BAM
+    void Align(unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2);
+    // aligns the query sequence to the reference and fills in the coordinates, score, mismatches and cigar of the alignment
+    void Align(CSmithWatermanAlignment& alignment, const string& s1, const string& s2);
+    // aligns each query sequence to its reference, several pairs per SIMD fill. The results are identical to calling Align on each pair.
+    void AlignBatch(vector<unsigned int>& referenceAls, vector<string>& cigarAls, vector<float>& bestScores, const vector<string>& references, const vector<string>& queries);
+    // computes the best local alignment score without a traceback and returns the 0-based end positions of the best cell
+    float Score(const string& s1, const string& s2, unsigned int& referenceEnd, unsigned int& queryEnd);
     // enables homo-polymer scoring
     void EnableHomoPolymerGapPenalty(float hpGapOpenPenalty);
     // enables non-repeat gap open penalty
     void EnableEntropyGapPenalty(float enGapOpenPenalty);
     // enables repeat gap extension penalty
     void EnableRepeatGapExtensionPenalty(float rGapExtensionPenalty, float rMaxGapRepeatExtensionPenaltyFactor = 10);
+    // scales the scoring parameters to integers (by 1, 10, 100 or 1000) so that every score is computed exactly. Returns false and keeps the float scores if no scale makes all parameters integral.
+    bool EnableIntegerScoring(void);
+    // enables the half byte per cell traceback matrix (direction and gap extension flags, the gap lengths are rebuilt during the traceback)
+    void EnableCompactTraceback(void);
+    // sets the largest number of cells for which the whole traceback matrix is stored. Larger alignments are traced back in linear space.
+    void SetMaxMatrixSize(size_t maxMatrixSize);
+    // makes the scalar fill test the gap penalty options in every cell instead of using the fill compiled for them (for benchmarking)
+    void DisableFillSpecialization(void);
+    // enables the checkpointed traceback: the scores of every sqrt(n)-th row are kept and the traceback matrix is refilled one block of rows at a time
+    void EnableCheckpointTraceback(void);
     // record the best score for external use
     float BestScore;
 private:
+    // fills the score matrix and traces back the best alignment, on the scaled scores
+    void FillAndTraceback(unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2);
     // creates a simple scoring matrix to align the nucleotides and the ambiguity code N
     void CreateScoringMatrix(void);
-    // corrects the homopolymer gap order for forward alignments
-    void CorrectHomopolymerGapOrder(const unsigned int numBases, const unsigned int numMismatches);
+    // picks the integer scale of the scoring parameters and rebuilds the scores. Returns false if no scale is exact.
+    bool UpdateScoreScale(void);
+    // returns the scoring parameter on the integer scale
+    float ScaleScore(const float score) const;
+    // returns the score on the scale of the scoring parameters
+    float UnscaleScore(const float score) const;
+    // returns true if the SIMD fills can be used for the current scoring options
+    bool UseSimdAlignment(void) const;
+    // returns true if the compact traceback can be used for the current scoring options
+    bool UseCompactTraceback(void) const;
+    // returns true if the traceback matrix of s1 against s2 exceeds the matrix size budget and can be rebuilt block by block
+    bool UseLinearSpaceTraceback(const string& s1, const string& s2) const;
+    // returns true if the checkpointed traceback can be used for the current scoring options
+    bool UseCheckpointTraceback(void) const;
+    // computes the repeat counts and entropies used by the gap penalties
+    void InitializeGapPenalties(const string& s1, const string& s2);
+    // computes the entropy of the window around every position of s, sliding the window one base at a time
+    void InitializeEntropies(const string& s, vector<float>& entropies) const;
+    // grows the score vectors to the query length
+    void InitializeScoreVectors(const unsigned int queryLen);
+    // adds the query profile rows of the reference symbols, starting a new profile when the query changes
+    void InitializeQueryProfile(const string& s1, const string& s2);
+    // fills the score vectors row by row and locates the best cell, storing the traceback matrices if requested
+    template<bool StoreTraceback>
+    void FillScores(const string& s1, const string& s2, unsigned int& BestRow, unsigned int& BestColumn);
+    // advances the score vectors over the rows firstRow..lastRow and locates the best cell among them, storing the traceback matrices if requested
+    template<bool StoreTraceback>
+    void FillScores(const string& s1, const string& s2, const unsigned int firstRow, const unsigned int lastRow, const bool compactTraceback, float& bestScore, unsigned int& BestRow, unsigned int& BestColumn);
+    // the fill kernel, compiled for one set of gap penalties or testing them in every cell
+    template<bool StoreTraceback, bool Specialized, bool HomoPolymer, bool Entropy, bool Repeat>
+    void FillScoreRows(const string& s1, const string& s2, const unsigned int firstRow, const unsigned int lastRow, const bool compactTraceback, float& bestScore, unsigned int& BestRow, unsigned int& BestColumn);
+    // row interface of the scalar fill, shared with the striped fill for the linear space traceback
+    unsigned int BeginRowFill(const string& s1, const string& s2);
+    void InitializeRowState(char* pRowState) const;
+    void FillRows(char* pRowState, const unsigned int firstRow, const unsigned int lastRow, const bool storeTraceback, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn);
+    CPackedTracebackMatrix GetTracebackMatrix(void) const;
+    // grows the buffer holding the compact traceback matrix
+    void InitializeCompactMatrix(const size_t numCells);
+    // aligns the sequences keeping only O(log n) rows of scores, refilling blocks of rows of the traceback matrix as the traceback reaches them
+    template<class RowFiller>
+    void AlignLinearSpace(RowFiller& filler, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2);
+    // aligns the sequences keeping the scores of every sqrt(n)-th row, refilling one block of rows of the traceback matrix at a time
+    template<class RowFiller>
+    void AlignCheckpointed(RowFiller& filler, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2);
+    // traces back through the rows topRow+1..bottomRow given the score vectors of topRow, halving the rows until a block fits the matrix size budget
+    template<class RowFiller>
+    void TracebackRows(RowFiller& filler, CTracebackState& state, const string& s1, const string& s2, const unsigned int topRow, const unsigned int bottomRow, const vector<char>& topRowState);
+    // traces back from the best cell and creates the cigar
+    template<class TracebackMatrix>
+    void Traceback(const TracebackMatrix& matrix, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2, const unsigned int BestRow, const unsigned int BestColumn);
+    // follows the traceback pointers until the stop cell or the top row of the matrix
+    template<class TracebackMatrix>
+    void TracebackCells(const TracebackMatrix& matrix, CTracebackState& state, const string& s1, const string& s2, const unsigned int topRow);
+    // counts the mismatched bases of the cigar aligning s2 to s1 from referenceBegin on
+    unsigned int CountMismatches(const vector<uint32_t>& cigar, const string& s1, const string& s2, const unsigned int referenceBegin) const;
+    // returns true if the match of s1[ci] and s2[cj] can trade places with the gap traced last
+    bool IsExchangeableWithGap(const vector<uint32_t>& reversedCigar, const string& s1, const string& s2, const int ci, const int cj) const;
+    // creates the cigar from the traced back operations and left-aligns it if needed
+    void FinishTraceback(const CTracebackState& state, unsigned int& referenceAl, vector<uint32_t>& cigarAl, const string& s1, const string& s2, const unsigned int BestColumn);
     // returns the maximum floating point number
     static inline float MaxFloats(const float& a, const float& b, const float& c);
     // our simple scoring matrix
     float mScoringMatrix[MOSAIK_NUM_NUCLEOTIDES][MOSAIK_NUM_NUCLEOTIDES];
     // keep track of maximum initialized sizes
-    unsigned int mCurrentMatrixSize;
+    size_t mCurrentMatrixSize;
     unsigned int mCurrentAnchorSize;
     unsigned int mCurrentQuerySize;
-    unsigned int mCurrentAQSumSize;
+    size_t mCurrentCompactMatrixSize;
+    // the largest traceback matrix (in cells) that is stored in full
+    size_t mMaxMatrixSize;
+    static const size_t DEFAULT_MAX_MATRIX_SIZE;
     // define our traceback directions
     // N.B. This used to be defined as an enum, but gcc doesn't like being told
     // which storage class to use
@@ -68,13 +193,41 @@ private:
     short* mSizesOfVerticalGaps;
     // store the horizontal gap sizes - assuming gaps are not longer than 32768 bases long
     short* mSizesOfHorizontalGaps;	
+    // store the backtrace pointers and gap extension flags, two cells per byte
+    char* mCompactPointers;
+    // first row of the compact traceback matrix
+    unsigned int mCompactFirstRow;
+    // the sequences of the current row fill
+    const string* mpReference;
+    const string* mpQuery;
+    // repeat structure around every position, used by the repeat gap extension penalty
+    vector<TandemRepeat> mReferenceRepeats;
+    vector<TandemRepeat> mQueryRepeats;
+    // the query of the query profile
+    string mProfileQuery;
+    // substitution scores of a reference symbol against every query base, one row per reference symbol seen so far
+    vector<float> mQueryProfile;
+    // profile row of every byte value, -1 if the row is not built yet
+    int mProfileRows[256];
+    // sequence entropy around every position, used by the entropy gap open penalty
+    vector<float> mReferenceEntropies;
+    vector<float> mQueryEntropies;
     // score if xi aligns to a gap after yi
     float* mQueryGapScores;
+    // size of the vertical gap ending in each column of the previous row
+    short* mQueryGapSizes;
     // best score of alignment x1...xi to y1...yi
     float* mBestScores;
-    // our reversed alignment
-    char* mReversedAnchor;
-    char* mReversedQuery;
+    // the cigar operations of the current traceback, from the best cell backwards
+    vector<uint32_t> mReversedCigar;
+    // the packed cigar behind the string cigar of Align and AlignBatch
+    vector<uint32_t> mPackedCigar;
+    // mismatched bases of the last alignment
+    unsigned int mNumMismatches;
+    // the buffers of the left-aligner, kept from one alignment to the next
+    LeftAlignWorkspace mLeftAlignWorkspace;
+    // the cigar before left-alignment, restored if the left-aligner fails
+    vector<uint32_t> mUnalignedCigar;
     // define static constants
     static const float FLOAT_NEGATIVE_INFINITY;
     // toggles the use of the homo-polymer gap open penalty
@@ -91,6 +244,19 @@ private:
     float mRepeatGapExtensionPenalty;
     // specifies the max repeat gap extension penalty
     float mMaxRepeatGapExtensionPenalty;
+    // toggles the use of the compact traceback matrix
+    bool mUseCompactTraceback;
+    // toggles the use of the checkpointed traceback
+    bool mUseCheckpointTraceback;
+    // toggles the fills compiled for each set of gap penalties
+    bool mSpecializeFill;
+    // toggles the integer scoring and the factor applied to the scoring parameters
+    bool mUseIntegerScoring;
+    float mScoreScale;
+    // striped SIMD fill for plain affine gap scoring
+    CStripedSmithWaterman mStripedAligner;
+    // inter-sequence SIMD fill for batches of short pairs
+    CBatchSmithWaterman mBatchAligner;
 };
 
 // returns the maximum floating point number
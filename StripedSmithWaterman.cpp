@@ -0,0 +1,209 @@
+#include "StripedSmithWaterman.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "SimdKernels.h"
+#include "SimdVectors.h"
+
+// ===========
+// the aligner
+// ===========
+
+CStripedSmithWaterman::CStripedSmithWaterman(const float* pScoringMatrix, float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty)
+    : mpKernels(GetSimdKernels())
+    , mpScoringMatrix(pScoringMatrix)
+    , mMatchScore(matchScore)
+    , mMismatchScore(mismatchScore)
+    , mGapOpenPenalty(gapOpenPenalty)
+    , mGapExtendPenalty(gapExtendPenalty)
+    , mCurrentWorkspaceSize(0)
+    , mCurrentTracebackSize(0)
+    , mWorkspace(NULL)
+    , mTraceback(NULL)
+    , mpReference(NULL)
+    , mpQuery(NULL)
+    , mNumSymbols(0)
+    , mUseShortScores(false)
+    , mVectorSize(1)
+    , mSegmentLength(1)
+    , mNumLanes(1)
+    , mFirstRow(1)
+    , mCompactTraceback(false)
+{}
+
+CStripedSmithWaterman::~CStripedSmithWaterman(void) {
+#if defined(SIMD_VECTORS)
+    if(mWorkspace) _mm_free(mWorkspace);
+#endif
+    if(mTraceback) delete [] mTraceback;
+}
+
+// returns true if a SIMD kernel can be used on this CPU
+bool CStripedSmithWaterman::IsAvailable(void) {
+    return GetSimdKernels() != NULL;
+}
+
+// stores the traceback matrix with two cells per byte
+void CStripedSmithWaterman::EnableCompactTraceback(void) {
+    mCompactTraceback = true;
+}
+
+// replaces the scoring parameters
+void CStripedSmithWaterman::SetScores(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty) {
+    mMatchScore       = matchScore;
+    mMismatchScore    = mismatchScore;
+    mGapOpenPenalty   = gapOpenPenalty;
+    mGapExtendPenalty = gapExtendPenalty;
+}
+
+// returns true if the gap penalties can be handled by the striped kernels
+bool CStripedSmithWaterman::IsSupported(void) const {
+    // the padding lanes rely on gaps never increasing a score
+    return (mGapOpenPenalty >= 0.0f) && (mGapExtendPenalty >= 0.0f);
+}
+
+// returns true if the alignment can be computed in 16-bit integer lanes
+bool CStripedSmithWaterman::UseShortScores(const unsigned int referenceLength, const unsigned int queryLength) const {
+
+    return SimdShortScoresFit(mMatchScore, mMismatchScore, mGapOpenPenalty, mGapExtendPenalty, min(referenceLength, queryLength));
+}
+
+// fills the packed traceback matrix and locates the best cell
+void CStripedSmithWaterman::Fill(const string& s1, const string& s2, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn) {
+    BeginRowFill(s1, s2);
+    FillRows(NULL, 1, s1.length(), true, bestScore, bestRow, bestColumn);
+}
+
+// locates the best cell without storing the traceback matrix
+void CStripedSmithWaterman::Score(const string& s1, const string& s2, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn) {
+    BeginRowFill(s1, s2);
+    FillRows(NULL, 1, s1.length(), false, bestScore, bestRow, bestColumn);
+}
+
+// prepares the fill of s1 against s2 and returns the size in bytes of the score vectors of one row
+unsigned int CStripedSmithWaterman::BeginRowFill(const string& s1, const string& s2) {
+
+#if defined(SIMD_VECTORS)
+
+    if(!mpKernels) {
+	printf("ERROR: The striped Smith-Waterman algorithm is not available on this CPU.\n");
+	exit(1);
+    }
+
+    mpReference = &s1;
+    mpQuery     = &s2;
+
+    const unsigned int referenceLength = s1.length();
+    const unsigned int queryLength     = s2.length();
+    mUseShortScores                    = UseShortScores(referenceLength, queryLength);
+
+    mNumLanes      = mUseShortScores ? mpKernels->ShortLanes : mpKernels->FloatLanes;
+    mVectorSize    = mUseShortScores ? mpKernels->ShortVectorSize : mpKernels->FloatVectorSize;
+    mSegmentLength = (queryLength + mNumLanes - 1) / mNumLanes;
+
+    // collect the distinct reference symbols, each gets a profile row
+    bool seen[256];
+    memset(seen, 0, sizeof(seen));
+    memset(mSymbolRows, 0, sizeof(mSymbolRows));
+    mNumSymbols = 0;
+    for(unsigned int i = 0; i < referenceLength; i++) {
+	const unsigned char c = s1[i];
+	if(!seen[c]) {
+	    seen[c]               = true;
+	    mSymbolRows[c]        = mNumSymbols;
+	    mSymbols[mNumSymbols] = c;
+	    mNumSymbols++;
+	}
+    }
+
+    // reinitialize our workspace
+    const unsigned int workspaceSize = (mNumSymbols + 7) * mSegmentLength * mVectorSize;
+    if(workspaceSize > mCurrentWorkspaceSize) {
+	if(mWorkspace) _mm_free(mWorkspace);
+	mCurrentWorkspaceSize = workspaceSize;
+	mWorkspace = (char*)_mm_malloc(mCurrentWorkspaceSize, 64);
+	if(!mWorkspace) {
+	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
+	    exit(1);
+	}
+    }
+
+    return 2 * mSegmentLength * mVectorSize;
+
+#else
+    printf("ERROR: The striped Smith-Waterman algorithm is not available in this build.\n");
+    exit(1);
+#endif
+}
+
+// sets the row state to the score vectors of row 0
+void CStripedSmithWaterman::InitializeRowState(char* pRowState) const {
+
+    mpKernels->InitializeStripedRowState[mUseShortScores](pRowState, mSegmentLength);
+}
+
+// fills the rows firstRow..lastRow, starting from and updating the row state when one is given, and locates the best cell among them
+void CStripedSmithWaterman::FillRows(char* pRowState, const unsigned int firstRow, const unsigned int lastRow, const bool storeTraceback, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn) {
+
+#if defined(SIMD_VECTORS)
+
+    // reinitialize our traceback matrix
+    const size_t tracebackSize = (size_t)(lastRow - firstRow + 1) * mSegmentLength * mNumLanes / (mCompactTraceback ? 2 : 1);
+    if(storeTraceback && (tracebackSize > mCurrentTracebackSize)) {
+	if(mTraceback) delete [] mTraceback;
+	mCurrentTracebackSize = tracebackSize;
+	try {
+	    mTraceback = new char[mCurrentTracebackSize];
+	} catch(bad_alloc) {
+	    cout << "ERROR: Unable to allocate enough memory for the Smith-Waterman algorithm." << endl;
+	    exit(1);
+	}
+    }
+
+    CStripedFillParameters p;
+    p.Reference        = mpReference->data();
+    p.ReferenceLength  = mpReference->length();
+    p.FirstRow         = firstRow;
+    p.LastRow          = lastRow;
+    p.RowState         = pRowState;
+    p.Query            = mpQuery->data();
+    p.QueryLength      = mpQuery->length();
+    p.ScoringMatrix    = mpScoringMatrix;
+    p.GapOpenPenalty   = mGapOpenPenalty;
+    p.GapExtendPenalty = mGapExtendPenalty;
+    p.Symbols          = mSymbols;
+    p.NumSymbols       = mNumSymbols;
+    p.SymbolRows       = mSymbolRows;
+    p.SegmentLength    = mSegmentLength;
+    p.Workspace        = mWorkspace;
+    p.Traceback        = mTraceback;
+    p.CompactTraceback = mCompactTraceback;
+    p.RowTraceback     = mWorkspace + (mNumSymbols + 6) * mSegmentLength * mVectorSize;
+
+    mFirstRow = firstRow;
+
+    mpKernels->StripedFill[mUseShortScores][storeTraceback](p, bestScore, bestRow, bestColumn);
+
+#else
+    printf("ERROR: The striped Smith-Waterman algorithm is not available in this build.\n");
+    exit(1);
+#endif
+}
+
+// returns a view of the packed traceback matrix written by the last fill
+CPackedTracebackMatrix CStripedSmithWaterman::GetTracebackMatrix(void) const {
+    CPackedTracebackMatrix matrix;
+    matrix.Cells         = mTraceback;
+    matrix.RowStride     = mSegmentLength * mNumLanes;
+    matrix.SegmentLength = mSegmentLength;
+    matrix.SegmentStride = mNumLanes;
+    matrix.LaneStride    = 1;
+    matrix.TopRow        = mFirstRow - 1;
+    matrix.Compact       = mCompactTraceback;
+    return matrix;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include "Mosaik.h"
+#include "TracebackMatrix.h"
+
+using namespace std;
+
+struct CSimdKernels;
+
+#define MOSAIK_NUM_NUCLEOTIDES 26
+
+// ============================================================================
+// Striped SIMD fill for the Smith-Waterman-Gotoh local alignment (Farrar 2007)
+//
+// The query is split into segments that are spread over the vector lanes, so
+// that the diagonal and vertical recurrences are computed one vector at a
+// time and the horizontal gap recurrence only needs a short lazy correction
+// loop per reference row. Scores are held in 16-bit saturating lanes when the
+// scoring parameters are integral and the best possible score fits, and in
+// single precision lanes otherwise. Either way the cell values, the best cell
+// and the packed traceback are identical to the scalar float recurrence in
+// CSmithWatermanGotoh::Align.
+// ============================================================================
+
+class CStripedSmithWaterman {
+public:
+    // constructor
+    CStripedSmithWaterman(const float* pScoringMatrix, float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty);
+    // destructor
+    ~CStripedSmithWaterman(void);
+    // returns true if a SIMD kernel can be used on this CPU
+    static bool IsAvailable(void);
+    // stores the traceback matrix with two cells per byte
+    void EnableCompactTraceback(void);
+    // replaces the scoring parameters, the scoring matrix is updated by its owner
+    void SetScores(float matchScore, float mismatchScore, float gapOpenPenalty, float gapExtendPenalty);
+    // returns true if the gap penalties can be handled by the striped kernels
+    bool IsSupported(void) const;
+    // fills the packed traceback matrix of s1 (reference, rows) against s2 (query, columns) and locates the best cell
+    void Fill(const string& s1, const string& s2, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn);
+    // locates the best cell of s1 against s2 without storing the traceback matrix
+    void Score(const string& s1, const string& s2, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn);
+    // prepares the fill of s1 against s2 in blocks of rows and returns the size in bytes of the score vectors of one row
+    unsigned int BeginRowFill(const string& s1, const string& s2);
+    // sets the row state to the score vectors of row 0
+    void InitializeRowState(char* pRowState) const;
+    // fills the rows firstRow..lastRow, starting from and updating the row state when one is given, and locates the best cell among them
+    void FillRows(char* pRowState, const unsigned int firstRow, const unsigned int lastRow, const bool storeTraceback, float& bestScore, unsigned int& bestRow, unsigned int& bestColumn);
+    // returns a view of the packed traceback matrix written by the last fill
+    CPackedTracebackMatrix GetTracebackMatrix(void) const;
+private:
+    // returns true if the alignment can be computed in 16-bit integer lanes
+    bool UseShortScores(const unsigned int referenceLength, const unsigned int queryLength) const;
+    // the fill kernels picked for this CPU
+    const CSimdKernels* mpKernels;
+    // the 26x26 scoring matrix owned by the caller
+    const float* mpScoringMatrix;
+    // define scoring constants
+    float mMatchScore;
+    float mMismatchScore;
+    float mGapOpenPenalty;
+    float mGapExtendPenalty;
+    // keep track of maximum initialized sizes
+    unsigned int mCurrentWorkspaceSize;
+    size_t mCurrentTracebackSize;
+    // aligned storage for the query profile and the score vectors
+    char* mWorkspace;
+    // packed traceback cells in striped order
+    char* mTraceback;
+    // the sequences of the current fill
+    const string* mpReference;
+    const string* mpQuery;
+    // distinct reference symbols and the profile row of every byte value
+    unsigned char mSymbols[256];
+    unsigned char mSymbolRows[256];
+    unsigned int mNumSymbols;
+    // geometry of the current fill
+    bool mUseShortScores;
+    unsigned int mVectorSize;
+    unsigned int mSegmentLength;
+    unsigned int mNumLanes;
+    // first row of the stored traceback matrix
+    unsigned int mFirstRow;
+    // toggles the two cells per byte traceback layout
+    bool mCompactTraceback;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+
+// ============================================================================
+// packed traceback cells
+//
+// The SIMD fill kernels store one byte per cell: the traceback direction in
+// the low two bits (same values as CSmithWatermanGotoh::Directions_*) and two
+// flags recording whether the vertical or the horizontal gap was extended
+// into this cell rather than opened here. The gap lengths are reconstructed
+// during the traceback by following the extension flags. Since a cell only
+// needs four bits, the compact layout stores two cells per byte, the cell
+// with the even index in the low nibble.
+// ============================================================================
+
+const char TRACEBACK_STOP              = 0;
+const char TRACEBACK_LEFT              = 1;
+const char TRACEBACK_DIAGONAL          = 2;
+const char TRACEBACK_UP                = 3;
+const char TRACEBACK_DIRECTION_MASK    = 3;
+const char TRACEBACK_VERTICAL_EXTEND   = 4;
+const char TRACEBACK_HORIZONTAL_EXTEND = 8;
+
+// read-only view of a packed traceback matrix. Cell (i, j) with 1-based
+// reference row i and query column j lives at
+//
+//   (i - 1) * RowStride + ((j - 1) % SegmentLength) * SegmentStride + ((j - 1) / SegmentLength) * LaneStride
+//
+// which covers both the striped query layout and plain row-major layouts
+// (SegmentLength >= query length). Row 0 and column 0 are implicit STOP cells.
+// When Compact is set the index addresses nibbles rather than bytes. A matrix
+// holding only a block of rows sets TopRow to the row above its first stored
+// row; the gap lengths are then only followed down to the block boundary.
+struct CPackedTracebackMatrix {
+    const char*  Cells;
+    unsigned int RowStride;
+    unsigned int SegmentLength;
+    unsigned int SegmentStride;
+    unsigned int LaneStride;
+    unsigned int TopRow;
+    bool         Compact;
+
+    CPackedTracebackMatrix(void)
+	: Cells(NULL)
+	, RowStride(0)
+	, SegmentLength(1)
+	, SegmentStride(0)
+	, LaneStride(0)
+	, TopRow(0)
+	, Compact(false)
+    {}
+
+    // returns the packed cell at row i and column j (both > 0)
+    inline char Cell(const unsigned int i, const unsigned int j) const {
+	const unsigned int q = j - 1;
+	const size_t index = (size_t)(i - 1 - TopRow) * RowStride + (q % SegmentLength) * SegmentStride + (q / SegmentLength) * LaneStride;
+	if(Compact) return (Cells[index >> 1] >> ((index & 1) << 2)) & 0x0F;
+	return Cells[index];
+    }
+
+    // returns the traceback direction
+    inline char Direction(const unsigned int i, const unsigned int j) const {
+	if((i == 0) || (j == 0)) return TRACEBACK_STOP;
+	return Cell(i, j) & TRACEBACK_DIRECTION_MASK;
+    }
+
+    // returns the length of the vertical gap ending in this cell. In a block of
+    // rows a gap still open at the first stored row counts one row into the
+    // block above.
+    inline unsigned int VerticalGapLength(unsigned int i, const unsigned int j) const {
+	unsigned int length = 1;
+	while((i > TopRow) && (Cell(i, j) & TRACEBACK_VERTICAL_EXTEND)) {
+	    length++;
+	    i--;
+	}
+	return length;
+    }
+
+    // returns the length of the horizontal gap ending in this cell
+    inline unsigned int HorizontalGapLength(const unsigned int i, unsigned int j) const {
+	unsigned int length = 1;
+	while((j > 0) && (Cell(i, j) & TRACEBACK_HORIZONTAL_EXTEND)) {
+	    length++;
+	    j--;
+	}
+	return length;
+    }
+};
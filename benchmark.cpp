@@ -0,0 +1,330 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "SmithWatermanGotoh.h"
+#include "LeftAlign.h"
+#include "SeededSmithWaterman.h"
+
+using namespace std;
+
+// micro benchmarks for the Smith-Waterman aligners
+//
+// usage: benchmark [name ...]
+//
+// runs the named benchmarks, or all of them when no name is given
+
+// returns the wall clock time in seconds
+static double now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// returns a pseudo-random DNA sequence
+static string randomSequence(const unsigned int length) {
+    static const char bases[] = "ACGT";
+    string sequence(length, 'A');
+    for(unsigned int i = 0; i < length; i++) sequence[i] = bases[rand() % 4];
+    return sequence;
+}
+
+// returns a copy of the sequence with a substitution every period bases
+static string mutateSequence(const string& sequence, const unsigned int period) {
+    static const char bases[] = "ACGT";
+    string mutated = sequence;
+    for(unsigned int i = period / 2; i < mutated.length(); i += period) mutated[i] = bases[(strchr(bases, mutated[i]) - bases + 1) % 4];
+    return mutated;
+}
+
+// returns the average time in microseconds of aligning every pair once
+static double timeAlignments(CSmithWatermanGotoh& sw, const vector<string>& references, const vector<string>& queries) {
+    unsigned int referenceAl;
+    string cigarAl;
+    const double start = now();
+    for(unsigned int k = 0; k < references.size(); k++) sw.Align(referenceAl, cigarAl, references[k], queries[k]);
+    return (now() - start) * 1e6 / references.size();
+}
+
+// per-call cost of short alignments before and after one large alignment
+static void benchmarkMatrixReuse(void) {
+
+    cout << "matrix-reuse: short alignments before and after a large one" << endl;
+
+    // the homopolymer gap penalty keeps the aligner on the scalar path that owns the traceback matrices
+    CSmithWatermanGotoh sw(10.0f, -9.0f, 15.0f, 6.66f);
+    sw.EnableHomoPolymerGapPenalty(9.0f);
+
+    vector<string> references, queries;
+    for(unsigned int k = 0; k < 2000; k++) {
+	references.push_back(randomSequence(100));
+	queries.push_back(mutateSequence(references.back().substr(20, 50), 10));
+    }
+
+    const double before = timeAlignments(sw, references, queries);
+
+    const string largeReference = randomSequence(4000);
+    const string largeQuery     = mutateSequence(largeReference, 25);
+    unsigned int referenceAl;
+    string cigarAl;
+    const double largeStart = now();
+    sw.Align(referenceAl, cigarAl, largeReference, largeQuery);
+    const double large = now() - largeStart;
+
+    const double after = timeAlignments(sw, references, queries);
+
+    printf("    100x50 before large alignment:  %8.2f us/alignment\n", before);
+    printf("    4000x4000 alignment:            %8.2f ms\n", large * 1e3);
+    printf("    100x50 after large alignment:   %8.2f us/alignment\n", after);
+}
+
+// returns the average time in microseconds of scoring every pair once
+static double timeScores(CSmithWatermanGotoh& sw, const vector<string>& references, const vector<string>& queries) {
+    unsigned int referenceEnd, queryEnd;
+    const double start = now();
+    for(unsigned int k = 0; k < references.size(); k++) sw.Score(references[k], queries[k], referenceEnd, queryEnd);
+    return (now() - start) * 1e6 / references.size();
+}
+
+// scalar fill compiled for the enabled gap penalties against the generic fill testing them in every cell
+static void benchmarkFillSpecialization(void) {
+
+    cout << "fill-specialization: specialized and generic scalar fills" << endl;
+
+    vector<string> references, queries;
+    for(unsigned int k = 0; k < 500; k++) {
+	references.push_back(randomSequence(300));
+	queries.push_back(mutateSequence(references.back().substr(50, 150), 10));
+    }
+
+    static const char* names[] = { "homopolymer", "entropy", "homopolymer+entropy" };
+    for(unsigned int penalties = 1; penalties <= 3; penalties++) {
+	CSmithWatermanGotoh specialized(10.0f, -9.0f, 15.0f, 6.66f);
+	CSmithWatermanGotoh generic(10.0f, -9.0f, 15.0f, 6.66f);
+	generic.DisableFillSpecialization();
+	if(penalties & 1) {
+	    specialized.EnableHomoPolymerGapPenalty(9.0f);
+	    generic.EnableHomoPolymerGapPenalty(9.0f);
+	}
+	if(penalties & 2) {
+	    specialized.EnableEntropyGapPenalty(1.0f);
+	    generic.EnableEntropyGapPenalty(1.0f);
+	}
+
+	const double genericTime     = timeScores(generic, references, queries);
+	const double specializedTime = timeScores(specialized, references, queries);
+	printf("    %-20s 300x150 generic: %8.2f us  specialized: %8.2f us  speedup: %5.2fx\n", names[penalties - 1], genericTime, specializedTime, genericTime / specializedTime);
+    }
+}
+
+// returns a tandem repeat of count copies of a random unit
+static string tandemRepeat(const unsigned int unitLength, const unsigned int count) {
+    const string unit = randomSequence(unitLength);
+    string repeat;
+    for(unsigned int c = 0; c < count; c++) repeat += unit;
+    return repeat;
+}
+
+// left-aligns by calling leftAlign until the cigar stops changing, as stablyLeftAlign used to
+static void iterateLeftAlign(const string& query, vector<uint32_t>& cigar, const string& reference, int& offset, LeftAlignWorkspace& workspace) {
+    int iterations = 20;
+    while(leftAlign(query.data(), query.length(), cigar, reference.data(), reference.length(), offset, workspace) && --iterations > 0) { }
+}
+
+// single-pass indel normalization against iterating leftAlign on reads of short tandem repeats
+static void benchmarkLeftAlign(void) {
+
+    cout << "left-align: normalizing indels in tandem repeats" << endl;
+
+    // each read gains or loses a few repeat units, aligned at the right end of the repeat
+    vector<string> references, queries;
+    vector<vector<uint32_t> > cigars;
+    for(unsigned int k = 0; k < 2000; k++) {
+	const unsigned int unitLength = 1 + rand() % 4;
+	const unsigned int count      = 8 + rand() % 16;
+	const unsigned int indelUnits = 1 + rand() % 3;
+	const string left   = randomSequence(40);
+	const string repeat = tandemRepeat(unitLength, count);
+	const string right  = randomSequence(40);
+	const string indel  = repeat.substr(0, unitLength * indelUnits);
+
+	vector<uint32_t> cigar;
+	appendCigarOperation(cigar, left.length() + repeat.length(), CIGAR_M);
+	if(k % 2 == 0) {
+	    references.push_back(left + repeat + right);
+	    queries.push_back(left + repeat + indel + right);
+	    appendCigarOperation(cigar, indel.length(), CIGAR_I);
+	} else {
+	    references.push_back(left + repeat + indel + right);
+	    queries.push_back(left + repeat + right);
+	    appendCigarOperation(cigar, indel.length(), CIGAR_D);
+	}
+	appendCigarOperation(cigar, right.length(), CIGAR_M);
+	cigars.push_back(cigar);
+    }
+
+    LeftAlignWorkspace workspace;
+    vector<vector<uint32_t> > iterated(cigars), normalized(cigars);
+    vector<int> iteratedOffsets(cigars.size(), 0), normalizedOffsets(cigars.size(), 0);
+
+    const double iteratedStart = now();
+    for(unsigned int k = 0; k < cigars.size(); k++) iterateLeftAlign(queries[k], iterated[k], references[k], iteratedOffsets[k], workspace);
+    const double iteratedTime = (now() - iteratedStart) * 1e6 / cigars.size();
+
+    const double normalizedStart = now();
+    for(unsigned int k = 0; k < cigars.size(); k++) normalizeIndels(queries[k].data(), queries[k].length(), normalized[k], references[k].data(), references[k].length(), normalizedOffsets[k], workspace);
+    const double normalizedTime = (now() - normalizedStart) * 1e6 / cigars.size();
+
+    unsigned int numIdentical = 0;
+    for(unsigned int k = 0; k < cigars.size(); k++) {
+	if(iterated[k] == normalized[k] && iteratedOffsets[k] == normalizedOffsets[k]) numIdentical++;
+    }
+
+    printf("    iterated leftAlign: %8.2f us  normalizeIndels: %8.2f us  speedup: %5.2fx\n", iteratedTime, normalizedTime, iteratedTime / normalizedTime);
+    printf("    identical alignments: %u of %u\n", numIdentical, (unsigned int) cigars.size());
+}
+
+// orders alleles by their formatted text, as IndelAllele's operator< used to
+static bool formattedIndelLess(const IndelAllele& a, const IndelAllele& b) {
+    ostringstream as, bs;
+    as << a;
+    bs << b;
+    return as.str() < bs.str();
+}
+
+static void benchmarkIndelAlleles(void) {
+
+    cout << "indel-alleles: sorting and deduplicating indel candidates" << endl;
+
+    // many reads reporting the same few indels at nearby positions
+    vector<IndelAllele> alleles;
+    for(unsigned int k = 0; k < 200000; k++) {
+	const int length = 1 + rand() % 6;
+	alleles.push_back(IndelAllele(rand() % 2, length, 1000 + rand() % 200, rand() % 150, randomSequence(length).substr(0, 1 + rand() % 2)));
+    }
+    vector<CompactIndelAllele> compactAlleles(alleles.size());
+    for(unsigned int k = 0; k < alleles.size(); k++) compactIndelAllele(alleles[k], compactAlleles[k]);
+
+    vector<IndelAllele> formatted(alleles);
+    const double formattedStart = now();
+    sort(formatted.begin(), formatted.end(), formattedIndelLess);
+    const double formattedTime = (now() - formattedStart) * 1e3;
+
+    vector<IndelAllele> structured(alleles);
+    const double structuredStart = now();
+    sort(structured.begin(), structured.end());
+    const unsigned int numUnique = unique(structured.begin(), structured.end()) - structured.begin();
+    const double structuredTime = (now() - structuredStart) * 1e3;
+
+    vector<CompactIndelAllele> compact(compactAlleles);
+    const double compactStart = now();
+    sort(compact.begin(), compact.end());
+    const unsigned int numCompactUnique = unique(compact.begin(), compact.end()) - compact.begin();
+    const double compactTime = (now() - compactStart) * 1e3;
+
+    printf("    formatted: %8.2f ms  structured: %8.2f ms  compact: %8.2f ms  speedup: %5.2fx / %5.2fx\n",
+	   formattedTime, structuredTime, compactTime, formattedTime / structuredTime, formattedTime / compactTime);
+    printf("    distinct alleles: %u of %u (compact: %u)\n", numUnique, (unsigned int) alleles.size(), numCompactUnique);
+}
+
+// returns a copy of the sequence with an insertion or a deletion of one to three bases every period bases
+static string indelSequence(const string& sequence, const unsigned int period) {
+    string edited;
+    for(unsigned int i = 0; i < sequence.length(); i += period) {
+	const string block    = sequence.substr(i, period);
+	const unsigned int length = 1 + rand() % 3;
+	if(rand() % 2) edited += block.substr(0, period / 2) + randomSequence(length) + block.substr(period / 2);
+	else edited += block.substr(0, period / 2) + block.substr(min(period / 2 + length, (unsigned int) block.length()));
+    }
+    return edited;
+}
+
+// seeded banded alignment of near-diagonal pairs against the full aligner
+static void benchmarkSeededBanded(void) {
+
+    cout << "seeded-banded: near-diagonal pairs, banded around the seeded diagonal" << endl;
+
+    static const unsigned int lengths[] = { 250, 1000, 4000 };
+    for(unsigned int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+	const unsigned int numPairs = 400000 / lengths[l];
+	vector<string> references, queries;
+	for(unsigned int k = 0; k < numPairs; k++) {
+	    references.push_back(randomSequence(lengths[l]));
+	    queries.push_back(indelSequence(mutateSequence(references.back(), 25), 100));
+	}
+
+	CSmithWatermanGotoh sw(10.0f, -9.0f, 15.0f, 6.66f);
+	CSeededSmithWaterman seeded(10.0f, -9.0f, 15.0f, 6.66f, 33);
+
+	vector<unsigned int> fullPositions(numPairs), seededPositions(numPairs);
+	vector<string> fullCigars(numPairs), seededCigars(numPairs);
+
+	const double fullStart = now();
+	for(unsigned int k = 0; k < numPairs; k++) sw.Align(fullPositions[k], fullCigars[k], references[k], queries[k]);
+	const double fullTime = (now() - fullStart) * 1e6 / numPairs;
+
+	unsigned int numBanded = 0;
+	const double seededStart = now();
+	for(unsigned int k = 0; k < numPairs; k++) {
+	    seeded.Align(seededPositions[k], seededCigars[k], references[k], queries[k]);
+	    if(seeded.IsBanded) numBanded++;
+	}
+	const double seededTime = (now() - seededStart) * 1e6 / numPairs;
+
+	unsigned int numIdentical = 0;
+	for(unsigned int k = 0; k < numPairs; k++) {
+	    if((fullPositions[k] == seededPositions[k]) && (fullCigars[k] == seededCigars[k])) numIdentical++;
+	}
+
+	printf("    %4u bp  full: %9.2f us  seeded: %9.2f us  speedup: %6.2fx  banded: %u of %u  identical: %u\n",
+	       lengths[l], fullTime, seededTime, fullTime / seededTime, numBanded, numPairs, numIdentical);
+    }
+}
+
+// the available benchmarks
+struct CBenchmark {
+    const char* Name;
+    void (*Run)(void);
+};
+
+static const CBenchmark benchmarks[] = {
+    { "matrix-reuse",        benchmarkMatrixReuse },
+    { "fill-specialization", benchmarkFillSpecialization },
+    { "left-align",          benchmarkLeftAlign },
+    { "indel-alleles",       benchmarkIndelAlleles },
+    { "seeded-banded",       benchmarkSeededBanded },
+};
+
+static const unsigned int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+// returns true if the benchmark was named on the command line, or no name was given
+static bool isSelected(const char* name, int argc, char** argv) {
+    if(argc < 2) return true;
+    for(int a = 1; a < argc; a++) if(strcmp(argv[a], name) == 0) return true;
+    return false;
+}
+
+int main(int argc, char** argv) {
+
+    for(int a = 1; a < argc; a++) {
+	bool known = false;
+	for(unsigned int b = 0; b < numBenchmarks; b++) if(strcmp(argv[a], benchmarks[b].Name) == 0) known = true;
+	if(!known) {
+	    cerr << "unknown benchmark: " << argv[a] << endl;
+	    return 1;
+	}
+    }
+
+    for(unsigned int b = 0; b < numBenchmarks; b++) {
+	if(!isSelected(benchmarks[b].Name, argc, argv)) continue;
+	srand(1);
+	benchmarks[b].Run();
+    }
+
+    return 0;
+}
@@ -29,51 +29,8 @@
 #define        log2(x) (log((x)) * (1./M_LN2))
 #endif
 
-/** Frequecies for each byte */
-static int m_token_freqs[LIBDO_MAX_BYTES]; //frequency of each token in sample
-static float m_token_probs[LIBDO_MAX_BYTES]; //P(each token appearing)
-static int m_num_tokens = 0; //actual number of `seen' tokens, max 256 
-static float m_maxent = 0.0;
-static float m_ratio = 0.0;
-static int LIBDISORDER_INITIALIZED = 0;
-
-static void
-initialize_lib()
-{
-  int i = 0;
-  if(1==LIBDISORDER_INITIALIZED)
-    return;
-
-  m_num_tokens = 0;
-
-  for(i=0;i<LIBDO_MAX_BYTES;i++)
-  {
-    m_token_freqs[i]=0;
-    m_token_probs[i]=0.0;
-  }
-
-  LIBDISORDER_INITIALIZED = 1;
-}
-
-/**
- * Set m_num_tokens by iterating over m_token_freq[] and maintaining
- * a counter of each position that does not hold the value of zero.
- */
-static void
-count_num_tokens()
-{
-  int i = 0;
-  int counter = 0;
-  for(i=0;i<LIBDO_MAX_BYTES;i++)
-  {
-    if(0!=m_token_freqs[i])
-    {
-      counter++;
-    }
-  }
-  m_num_tokens = counter;
-  return;
-}
+/** Statistics of the last shannon_H call of each thread */
+static __thread struct libdo_stats m_last_stats = { 0, 0.0, 0.0 };
 
 /**
  * Sum frequencies for each token (i.e., byte values 0 through 255)
@@ -82,31 +39,22 @@ count_num_tokens()
  * This function is available only to functions in this file.
  */
 static void
-get_token_frequencies(char* buf, 
-		      long long length)
+get_token_frequencies(const char* buf, 
+		      long long length,
+		      int* token_freqs)
 {
-  int i=0;
-  char* itr=NULL;
-  unsigned char c=0;
-
-  itr = buf;
-
-  //reset number of tokens
-  m_num_tokens = 0;
+  long long i=0;
 
-  //make sure freqency and probability arrays are cleared
+  //make sure the freqency array is cleared
   for(i=0;i<LIBDO_MAX_BYTES;i++)
   {
-    m_token_freqs[i] = 0;
-    m_token_probs[i] = 0.0;
+    token_freqs[i] = 0;
   }
 
   for(i=0;i<length;i++)
   {
-    c = (unsigned char)*itr;
     //assert(0<=c<LIBDO_MAX_BYTES);
-    m_token_freqs[c]++;
-    itr++;
+    token_freqs[(unsigned char)buf[i]]++;
   }
 }
 
@@ -120,72 +68,79 @@ get_token_frequencies(char* buf,
  * with a helpful hint on the `foreach' statement from here:
  *
  *    http://php.net/manual/en/control-structures.foreach.php
+ *
+ * The token frequencies live on the stack, so concurrent calls do not
+ * interfere with each other.
  */
-float shannon_H(char* buf, 
-	  long long length)
+float shannon_H_r(const char* buf, 
+	  long long length,
+	  struct libdo_stats* stats)
 {
   int i = 0;
   float bits = 0.0;
-  char* itr=NULL; //values of itr should be zero to 255
-  unsigned char token;
+  int token_freqs[LIBDO_MAX_BYTES]; //frequency of each token in sample
+  int num_tokens = 0; //actual number of `seen' tokens, max 256
   int num_events = 0; //`length' parameter
-  float freq = 0.0; //loop variable for holding freq from m_token_freq[]
+  float prob = 0.0; //P(token appearing)
   float entropy = 0.0; //running entropy sum
 
+  if(NULL!=stats)
+  {
+    stats->num_tokens = 0;
+    stats->maxent = 0.0;
+    stats->ratio = 0.0;
+  }
+
   if(NULL==buf || 0==length)
     return 0.0;
 
-  if(0==LIBDISORDER_INITIALIZED)
-    initialize_lib();
-
-  itr = buf;
-  m_maxent = 0.0;
-  m_ratio = 0.0;
   num_events = length;
-  get_token_frequencies(itr, num_events); //modifies m_token_freqs[]
-  //set m_num_tokens by counting unique m_token_freqs entries
-  count_num_tokens(); 
-
-  if(m_num_tokens>LIBDO_MAX_BYTES)
-  {
-    //report error somehow?
-    return 0.0;
-  }
+  get_token_frequencies(buf, num_events, token_freqs);
 
-  //iterate through whole m_token_freq array, but only count
+  //iterate through whole token_freqs array, but only count
   //spots that have a registered token (i.e., freq>0)
   for(i=0;i<LIBDO_MAX_BYTES;i++)
   {
-    if(0!=m_token_freqs[i])
+    if(0!=token_freqs[i])
     {
-      token = i;
-      freq = ((float)m_token_freqs[token]); 
-      m_token_probs[token] = (freq / ((float)num_events));
-      entropy += m_token_probs[token] * log2(m_token_probs[token]);
+      num_tokens++;
+      prob = ((float)token_freqs[i]) / ((float)num_events);
+      entropy += prob * log2(prob);
     }
   }
 
   bits = -1.0 * entropy;
-  m_maxent = log2(m_num_tokens);
-  m_ratio = bits / m_maxent;
+
+  if(NULL!=stats)
+  {
+    stats->num_tokens = num_tokens;
+    stats->maxent = log2(num_tokens);
+    stats->ratio = bits / stats->maxent;
+  }
 
   return bits;
 }
 
+float shannon_H(char* buf, 
+	  long long length)
+{
+  return shannon_H_r(buf, length, &m_last_stats);
+}
+
 int 
 get_num_tokens()
 {
-  return m_num_tokens;
+  return m_last_stats.num_tokens;
 }
 
 float 
 get_max_entropy()
 {
-  return m_maxent;
+  return m_last_stats.maxent;
 }
 
 float 
 get_entropy_ratio()
 {
-  return m_ratio;
+  return m_last_stats.ratio;
 }
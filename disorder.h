@@ -47,6 +47,24 @@
  */
 float    shannon_H(char*, long long);
 
+/** The token statistics of one entropy computation */
+struct libdo_stats
+{
+  int   num_tokens; //number of unique tokens seen
+  float maxent;     //maximum entropy for that number of tokens
+  float ratio;      //ratio of entropy to maxent
+};
+
+/**
+ * Re-entrant version of shannon_H: all of its state lives on the stack,
+ * so it may be called concurrently from several threads. The token
+ * statistics are stored in `stats' unless it is NULL.
+ */
+float    shannon_H_r(const char*, long long, struct libdo_stats*);
+
+/** The following report on the last call to shannon_H made by the
+    calling thread. */
+
 /** Report the number of (unique) tokens seen. This is _not_ the
     number of individual events seen. For example, if the library sees
     the string `aaab', the number of events is 4 and the number of
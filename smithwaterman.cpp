@@ -1,13 +1,18 @@
 #include <iostream>
+#include <fstream>
 #include <string.h>
 #include <string>
 #include <sstream>
 #include <getopt.h>
 #include <utility>
 #include <vector>
+#include <algorithm>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
 #include "SmithWatermanGotoh.h"
-#include "BandedSmithWaterman.h"
+#include "SeededSmithWaterman.h"
 
 using namespace std;
 
@@ -50,8 +55,444 @@ string reverseComplement(string read) {
 }
 
 
+// the scoring options shared by every alignment
+struct CAlignmentOptions {
+    float MatchScore;
+    float MismatchScore;
+    float GapOpenPenalty;
+    float GapExtendPenalty;
+    float EntropyGapOpenPenalty;
+    bool UseRepeatGapExtendPenalty;
+    float RepeatGapExtendPenalty;
+    int Bandwidth;
+    bool TryReverseComplement;
+    bool PrintAlignment;
+};
+
+// a reference/query pair and its alignment
+struct CAlignmentJob {
+    string Reference;
+    string Query;
+    unsigned int ReferencePos;
+    string Cigar;
+    float BestScore;
+    bool AlignedReverse;
+};
+
+// the aligners owned by one thread
+struct CAligners {
+    CSmithWatermanGotoh* Aligner;
+    CSeededSmithWaterman* SeededAligner;
+
+    CAligners(const CAlignmentOptions& options)
+        : Aligner(NULL)
+        , SeededAligner(NULL)
+    {
+        // the banded path falls back to the full aligner of the seeded front end
+        if (options.Bandwidth > 0) {
+            SeededAligner = new CSeededSmithWaterman(options.MatchScore, options.MismatchScore, options.GapOpenPenalty, options.GapExtendPenalty, options.Bandwidth);
+            Aligner = &SeededAligner->FullAligner;
+        } else {
+            Aligner = new CSmithWatermanGotoh(options.MatchScore, options.MismatchScore, options.GapOpenPenalty, options.GapExtendPenalty);
+        }
+        if (options.UseRepeatGapExtendPenalty)
+            Aligner->EnableRepeatGapExtensionPenalty(options.RepeatGapExtendPenalty);
+        if (options.EntropyGapOpenPenalty > 0)
+            Aligner->EnableEntropyGapPenalty(options.EntropyGapOpenPenalty);
+    }
+
+    ~CAligners(void) {
+        if (SeededAligner) delete SeededAligner;
+        else delete Aligner;
+    }
+};
+
+// aligns the query against the reference with the seeded banded aligner when
+// a bandwidth is given, with the full aligner otherwise, and returns the score
+float alignQuery(const CAlignmentOptions& options, CAligners& aligners, const string& reference, const string& query, unsigned int& referencePos, string& cigar) {
+
+    if (options.Bandwidth > 0) {
+        aligners.SeededAligner->Align(referencePos, cigar, reference, query);
+        return aligners.SeededAligner->BestScore;
+    }
+    aligners.Aligner->Align(referencePos, cigar, reference, query);
+    return aligners.Aligner->BestScore;
+}
+
+// aligns the query of the job against its reference
+void alignPair(const CAlignmentOptions& options, CAligners& aligners, CAlignmentJob& job) {
+
+    job.AlignedReverse = false;
+    job.BestScore = alignQuery(options, aligners, job.Reference, job.Query, job.ReferencePos, job.Cigar);
+
+    if (options.TryReverseComplement) {
+        string queryRevC = reverseComplement(job.Query);
+        unsigned int referencePosRevC;
+        string cigarRevC;
+        const float scoreRevC = alignQuery(options, aligners, job.Reference, queryRevC, referencePosRevC, cigarRevC);
+        if (scoreRevC > job.BestScore) {
+            job.AlignedReverse = true;
+            job.BestScore = scoreRevC;
+            job.ReferencePos = referencePosRevC;
+            job.Cigar = cigarRevC;
+            job.Query = queryRevC;
+        }
+    }
+}
+
+// prints the reference and the query with the gaps of the alignment
+void printAlignment(const string& reference, const string& query, const string& cigar, const unsigned int referencePos) {
+
+    int alignmentLength = 0;
+    int len;
+    string slen;
+    vector<pair<int, char> > cigarData;
+    for (string::const_iterator c = cigar.begin(); c != cigar.end(); ++c) {
+        switch (*c) {
+        case 'I':
+            len = atoi(slen.c_str());
+            slen.clear();
+            cigarData.push_back(make_pair(len, *c));
+            break;
+        case 'D':
+            len = atoi(slen.c_str());
+            alignmentLength += len;
+            slen.clear();
+            cigarData.push_back(make_pair(len, *c));
+            break;
+        case 'M':
+            len = atoi(slen.c_str());
+            alignmentLength += len;
+            slen.clear();
+            cigarData.push_back(make_pair(len, *c));
+            break;
+        case 'S':
+            len = atoi(slen.c_str());
+            slen.clear();
+            cigarData.push_back(make_pair(len, *c));
+            break;
+        default:
+            len = 0;
+            slen += *c;
+            break;
+        }
+    }
+
+    string gapped_ref = string(reference).substr(referencePos, alignmentLength);
+    string gapped_query = string(query);
+
+    int refpos = 0;
+    int readpos = 0;
+    for (vector<pair<int, char> >::iterator c = cigarData.begin(); c != cigarData.end(); ++c) {
+        int len = c->first;
+        switch (c->second) {
+        case 'I':
+            gapped_ref.insert(refpos, string(len, '-'));
+            readpos += len;
+            refpos += len;
+            break;
+        case 'D':
+            gapped_query.insert(readpos, string(len, '-'));
+            refpos += len;
+            readpos += len;
+            break;
+        case 'M':
+            readpos += len;
+            refpos += len;
+            break;
+        case 'S':
+            readpos += len;
+            gapped_ref.insert(refpos, string(len, '*'));
+            refpos += len;
+            break;
+        default:
+            break;
+        }
+    }
+
+    cout << gapped_ref << endl << gapped_query << endl;
+}
+
+// prints the result line of an alignment, optionally followed by the alignment itself
+void printJob(const CAlignmentOptions& options, const CAlignmentJob& job) {
+    printf("%s %3u %f %s\n", job.Cigar.c_str(), job.ReferencePos, job.BestScore, (job.AlignedReverse ? "-" : "+"));
+    if (options.PrintAlignment)
+        printAlignment(job.Reference, job.Query, job.Cigar, job.ReferencePos);
+}
+
+// =================
+// batch alignments
+// =================
+
+// the number of pairs read and aligned at a time
+const unsigned int BATCH_CHUNK_SIZE = 4096;
+
+// the jobs assigned to one worker, largest first. The owner takes jobs from
+// the front, idle workers steal from the back.
+struct CJobDeque {
+    vector<unsigned int> Jobs;
+    unsigned int Front;
+    unsigned int Back;
+    pthread_mutex_t Mutex;
+};
+
+// the work done by one worker
+struct CWorkerStats {
+    unsigned long NumJobs;
+    unsigned long NumStolen;
+    double BusyTime;
+};
+
+// the chunk of pairs currently being aligned and the state shared with the worker threads
+struct CBatchAlignment {
+    const CAlignmentOptions* Options;
+    vector<CAlignmentJob> Jobs;
+    unsigned int NumJobs;
+    // one deque and one set of statistics per worker
+    vector<CJobDeque> Deques;
+    vector<CWorkerStats> Stats;
+    // the workers still aligning the current chunk
+    unsigned int NumBusy;
+    // incremented for every chunk handed to the workers
+    unsigned int Generation;
+    // set when the input is exhausted
+    bool Finished;
+    pthread_mutex_t Mutex;
+    pthread_cond_t WorkReady;
+    pthread_cond_t WorkDone;
+};
+
+// the argument of a worker thread
+struct CWorkerArgument {
+    CBatchAlignment* Batch;
+    unsigned int Worker;
+};
+
+// returns the wall clock time in seconds
+double now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// returns the estimated cost of a job: the number of cells of its matrix
+double jobCost(const CAlignmentJob& job) {
+    return (double)(job.Reference.length() + 1) * (double)(job.Query.length() + 1);
+}
+
+// orders job indices by decreasing cost, ties in input order
+struct CLargestJobFirst {
+    const vector<double>& Costs;
+    CLargestJobFirst(const vector<double>& costs) : Costs(costs) {}
+    bool operator()(const unsigned int a, const unsigned int b) const {
+        return (Costs[a] > Costs[b]) || ((Costs[a] == Costs[b]) && (a < b));
+    }
+};
+
+// takes the next job from the front of a deque, returns false if it is empty
+bool takeFront(CJobDeque& deque, unsigned int& job) {
+    pthread_mutex_lock(&deque.Mutex);
+    const bool found = deque.Front < deque.Back;
+    if (found)
+        job = deque.Jobs[deque.Front++];
+    pthread_mutex_unlock(&deque.Mutex);
+    return found;
+}
+
+// takes the last job from the back of a deque, returns false if it is empty
+bool takeBack(CJobDeque& deque, unsigned int& job) {
+    pthread_mutex_lock(&deque.Mutex);
+    const bool found = deque.Front < deque.Back;
+    if (found)
+        job = deque.Jobs[--deque.Back];
+    pthread_mutex_unlock(&deque.Mutex);
+    return found;
+}
+
+// steals a job from the other workers, returns false once every deque is empty.
+// No jobs are added during a chunk, so an empty scan means the chunk is done.
+bool stealJob(CBatchAlignment& batch, const unsigned int worker, unsigned int& job) {
+    const unsigned int numWorkers = batch.Deques.size();
+    for (unsigned int v = 1; v < numWorkers; ++v) {
+        if (takeBack(batch.Deques[(worker + v) % numWorkers], job))
+            return true;
+    }
+    return false;
+}
+
+// aligns the jobs of every chunk until the input is exhausted
+void* alignmentWorker(void* arg) {
+
+    CBatchAlignment& batch = *((CWorkerArgument*)arg)->Batch;
+    const unsigned int worker = ((CWorkerArgument*)arg)->Worker;
+    CJobDeque& deque = batch.Deques[worker];
+    CWorkerStats& stats = batch.Stats[worker];
+    CAligners aligners(*batch.Options);
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&batch.Mutex);
+    while (true) {
+        while ((batch.Generation == generation) && !batch.Finished)
+            pthread_cond_wait(&batch.WorkReady, &batch.Mutex);
+        if (batch.Finished)
+            break;
+        generation = batch.Generation;
+        pthread_mutex_unlock(&batch.Mutex);
+
+        unsigned int job;
+        while (true) {
+            if (!takeFront(deque, job)) {
+                if (!stealJob(batch, worker, job))
+                    break;
+                ++stats.NumStolen;
+            }
+            const double start = now();
+            alignPair(*batch.Options, aligners, batch.Jobs[job]);
+            stats.BusyTime += now() - start;
+            ++stats.NumJobs;
+        }
+
+        pthread_mutex_lock(&batch.Mutex);
+        if (--batch.NumBusy == 0)
+            pthread_cond_signal(&batch.WorkDone);
+    }
+    pthread_mutex_unlock(&batch.Mutex);
+
+    return NULL;
+}
+
+// deals the jobs of a chunk to the worker deques, largest first, each job to
+// the worker with the least estimated work so far
+void scheduleJobs(CBatchAlignment& batch) {
+
+    const unsigned int numWorkers = batch.Deques.size();
+
+    vector<double> costs(batch.NumJobs);
+    vector<unsigned int> order(batch.NumJobs);
+    for (unsigned int k = 0; k < batch.NumJobs; ++k) {
+        costs[k] = jobCost(batch.Jobs[k]);
+        order[k] = k;
+    }
+    sort(order.begin(), order.end(), CLargestJobFirst(costs));
+
+    vector<double> load(numWorkers, 0.0);
+    for (unsigned int t = 0; t < numWorkers; ++t) {
+        batch.Deques[t].Jobs.clear();
+        batch.Deques[t].Front = 0;
+    }
+    for (unsigned int k = 0; k < batch.NumJobs; ++k) {
+        const unsigned int t = min_element(load.begin(), load.end()) - load.begin();
+        batch.Deques[t].Jobs.push_back(order[k]);
+        load[t] += costs[order[k]];
+    }
+    for (unsigned int t = 0; t < numWorkers; ++t)
+        batch.Deques[t].Back = batch.Deques[t].Jobs.size();
+}
+
+// aligns the whitespace separated reference/query pairs of the input on
+// numThreads threads and prints the results in input order. The jobs of
+// each chunk are scheduled largest first over per-thread deques, and idle
+// threads steal from the others.
+void alignBatch(const CAlignmentOptions& options, istream& input, const unsigned int numThreads, const bool printThreadStats) {
+
+    CBatchAlignment batch;
+    batch.Options = &options;
+    batch.Jobs.resize(BATCH_CHUNK_SIZE);
+    batch.NumJobs = 0;
+    batch.Deques.resize(numThreads);
+    batch.Stats.resize(numThreads);
+    batch.NumBusy = 0;
+    batch.Generation = 0;
+    batch.Finished = false;
+    pthread_mutex_init(&batch.Mutex, NULL);
+    pthread_cond_init(&batch.WorkReady, NULL);
+    pthread_cond_init(&batch.WorkDone, NULL);
+
+    vector<CWorkerArgument> arguments(numThreads);
+    for (unsigned int t = 0; t < numThreads; ++t) {
+        pthread_mutex_init(&batch.Deques[t].Mutex, NULL);
+        batch.Deques[t].Front = 0;
+        batch.Deques[t].Back = 0;
+        batch.Stats[t].NumJobs = 0;
+        batch.Stats[t].NumStolen = 0;
+        batch.Stats[t].BusyTime = 0;
+        arguments[t].Batch = &batch;
+        arguments[t].Worker = t;
+    }
+
+    const double start = now();
+    unsigned long numAligned = 0;
+
+    vector<pthread_t> threads(numThreads);
+    for (unsigned int t = 0; t < numThreads; ++t) {
+        if (pthread_create(&threads[t], NULL, alignmentWorker, &arguments[t]) != 0) {
+            cerr << "ERROR: Unable to create the alignment threads." << endl;
+            exit(1);
+        }
+    }
+
+    while (true) {
+        // the workers are idle between chunks, so the jobs can be refilled
+        unsigned int numJobs = 0;
+        while ((numJobs < BATCH_CHUNK_SIZE) && (input >> batch.Jobs[numJobs].Reference)) {
+            if (!(input >> batch.Jobs[numJobs].Query)) {
+                cerr << "ERROR: The input ends with reference " << batch.Jobs[numJobs].Reference << " but no query." << endl;
+                exit(1);
+            }
+            ++numJobs;
+        }
+        if (numJobs == 0)
+            break;
+
+        pthread_mutex_lock(&batch.Mutex);
+        batch.NumJobs = numJobs;
+        scheduleJobs(batch);
+        batch.NumBusy = numThreads;
+        ++batch.Generation;
+        pthread_cond_broadcast(&batch.WorkReady);
+        while (batch.NumBusy > 0)
+            pthread_cond_wait(&batch.WorkDone, &batch.Mutex);
+        pthread_mutex_unlock(&batch.Mutex);
+
+        for (unsigned int k = 0; k < numJobs; ++k)
+            printJob(options, batch.Jobs[k]);
+        numAligned += numJobs;
+
+        if (numJobs < BATCH_CHUNK_SIZE)
+            break;
+    }
+
+    pthread_mutex_lock(&batch.Mutex);
+    batch.Finished = true;
+    pthread_cond_broadcast(&batch.WorkReady);
+    pthread_mutex_unlock(&batch.Mutex);
+    for (unsigned int t = 0; t < numThreads; ++t)
+        pthread_join(threads[t], NULL);
+
+    for (unsigned int t = 0; t < numThreads; ++t)
+        pthread_mutex_destroy(&batch.Deques[t].Mutex);
+    pthread_cond_destroy(&batch.WorkDone);
+    pthread_cond_destroy(&batch.WorkReady);
+    pthread_mutex_destroy(&batch.Mutex);
+
+    fflush(stdout);
+    const double seconds = now() - start;
+    fprintf(stderr, "aligned %lu pairs in %.3f s on %u threads (%.1f alignments/s)\n",
+            numAligned, seconds, numThreads, (seconds > 0) ? numAligned / seconds : 0.0);
+
+    // the idle time includes reading the input and printing the results
+    if (printThreadStats) {
+        for (unsigned int t = 0; t < numThreads; ++t) {
+            const CWorkerStats& stats = batch.Stats[t];
+            fprintf(stderr, "thread %u: %lu pairs (%lu stolen), busy %.3f s, idle %.3f s\n",
+                    t, stats.NumJobs, stats.NumStolen, stats.BusyTime, max(0.0, seconds - stats.BusyTime));
+        }
+    }
+}
+
 void printSummary(void) {
     cerr << "usage: smithwaterman [options] <reference sequence> <query sequence>" << endl
+         << "       smithwaterman [options] -f <pairs file>" << endl
          << endl
          << "options:" << endl 
          << "    -m, --match-score         the match score (default 10.0)" << endl
@@ -60,13 +501,23 @@ void printSummary(void) {
          << "    -z, --entropy-gap-open-penalty  enable entropy scaling of the gap open penalty" << endl
          << "    -e, --gap-extend-penalty  the gap extend penalty (default 6.66)" << endl
          << "    -r, --repeat-gap-extend-penalty  use repeat information when generating gap extension penalties" << endl
-         << "    -b, --bandwidth           bandwidth to use (default 0, or non-banded algorithm)" << endl
+         << "    -b, --bandwidth           bandwidth to use around the k-mer seeded diagonal (default 0, or non-banded algorithm)" << endl
+         << "                              queries shorter than 12 bandwidths, where banding is slower, and pairs" << endl
+         << "                              without a seeded diagonal use the non-banded algorithm. The banded" << endl
+         << "                              alignment is not exact: it misses the best alignment when indels drift" << endl
+         << "                              the query more than half the bandwidth off the diagonal (1 in 5 4 kb" << endl
+         << "                              pairs with an indel every 100 bp at -b 33). Cannot be combined with -z or -r" << endl
          << "    -p, --print-alignment     print out the alignment" << endl
          << "    -R, --reverse-complement  report the reverse-complement alignment if it scores better" << endl
+         << "    -f, --pairs FILE          align the whitespace separated reference/query pairs in FILE (- for stdin)" << endl
+         << "    -t, --threads N           number of threads used with --pairs (default: number of CPUs)" << endl
+         << "    -T, --thread-stats        report the pairs and the busy and idle time of every thread with --pairs" << endl
          << endl
          << "When called with literal reference and query sequences, smithwaterman" << endl
          << "prints the cigar match positional string and the match position for the" << endl
-         << "query sequence against the reference sequence." << endl;
+         << "query sequence against the reference sequence. With --pairs every pair" << endl
+         << "is aligned and reported the same way, in input order, followed by the" << endl
+         << "alignment throughput on stderr." << endl;
 }
 
 
@@ -90,6 +541,10 @@ int main (int argc, char** argv) {
     bool print_alignment = false;
     bool tryReverseComplement = false;
 
+    string pairsFile;
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool printThreadStats = false;
+
     while (true) {
         static struct option long_options[] =
             {
@@ -103,11 +558,14 @@ int main (int argc, char** argv) {
                 {"print-alignment",  required_argument, 0, 'p'},
                 {"bandwidth", required_argument, 0, 'b'},
                 {"reverse-complement", no_argument, 0, 'R'},
+                {"pairs", required_argument, 0, 'f'},
+                {"threads", required_argument, 0, 't'},
+                {"thread-stats", no_argument, 0, 'T'},
                 {0, 0, 0, 0}
             };
         int option_index = 0;
 
-        c = getopt_long (argc, argv, "hpRzm:n:g:r:e:b:r:",
+        c = getopt_long (argc, argv, "hpRzTm:n:g:r:e:b:r:f:t:",
                          long_options, &option_index);
 
         if (c == -1)
@@ -161,6 +619,25 @@ int main (int argc, char** argv) {
         case 'p':
             print_alignment = true;
             break;
+
+        case 'f':
+            pairsFile = optarg;
+            break;
+
+        case 't':
+            {
+                char* end;
+                numThreads = strtol(optarg, &end, 10);
+                if ((end == optarg) || (*end != '\0') || (numThreads < 1)) {
+                    cerr << "ERROR: The number of threads must be a positive integer, got " << optarg << "." << endl;
+                    exit(1);
+                }
+            }
+            break;
+
+        case 'T':
+            printThreadStats = true;
+            break;
  
         case 'h':
             printSummary();
@@ -178,6 +655,46 @@ int main (int argc, char** argv) {
         }
     }
 
+    // the banded aligner only scores with the affine gap penalties
+    if ((bandwidth > 0) && ((entropyGapOpenPenalty > 0) || useRepeatGapExtendPenalty)) {
+        cerr << "ERROR: -z and -r cannot be combined with -b, the banded aligner does not support them." << endl;
+        exit(1);
+    }
+
+    CAlignmentOptions options;
+    options.MatchScore = matchScore;
+    options.MismatchScore = mismatchScore;
+    options.GapOpenPenalty = gapOpenPenalty;
+    options.GapExtendPenalty = gapExtendPenalty;
+    options.EntropyGapOpenPenalty = entropyGapOpenPenalty;
+    options.UseRepeatGapExtendPenalty = useRepeatGapExtendPenalty;
+    options.RepeatGapExtendPenalty = repeatGapExtendPenalty;
+    options.Bandwidth = bandwidth;
+    options.TryReverseComplement = tryReverseComplement;
+    options.PrintAlignment = print_alignment;
+
+    // align every pair of a file or stdin
+    if (!pairsFile.empty()) {
+        if (optind != argc) {
+            cerr << "please specify either a pairs file or a reference and query sequence" << endl
+                 << "execute " << argv[0] << " --help for command-line usage" << endl;
+            exit(1);
+        }
+        if (numThreads < 1)
+            numThreads = 1;
+        if (pairsFile == "-") {
+            alignBatch(options, cin, numThreads, printThreadStats);
+        } else {
+            ifstream input(pairsFile.c_str());
+            if (!input) {
+                cerr << "ERROR: Unable to open " << pairsFile << endl;
+                exit(1);
+            }
+            alignBatch(options, input, numThreads, printThreadStats);
+        }
+        return 0;
+    }
+
     /* Print any remaining command line arguments (not options). */
     if (optind == argc - 2) {
         //cerr << "fasta file: " << argv[optind] << endl;
@@ -190,116 +707,15 @@ int main (int argc, char** argv) {
         exit(1);
     }
 
-    // initialize
-	
-    unsigned int referencePos;
-    string cigar;
-
-    float bestScore = 0;
-
-    bool alignedReverse = false;
-
     // create a new Smith-Waterman alignment object
-    if (bandwidth > 0) {
-        pair< pair<unsigned int, unsigned int>, pair<unsigned int, unsigned int> > hr;
-        hr.first.first   = 2;
-        hr.first.second  = 18;
-        hr.second.first  = 1;
-        hr.second.second = 17;
-        CBandedSmithWaterman bsw(matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty, bandwidth);
-        bsw.Align(referencePos, cigar, reference, query, hr);
-    } else {
-        CSmithWatermanGotoh sw(matchScore, mismatchScore, gapOpenPenalty, gapExtendPenalty);
-        if (useRepeatGapExtendPenalty)
-            sw.EnableRepeatGapExtensionPenalty(repeatGapExtendPenalty);
-        if (entropyGapOpenPenalty > 0)
-            sw.EnableEntropyGapPenalty(entropyGapOpenPenalty);
-        sw.Align(referencePos, cigar, reference, query);
-        bestScore = sw.BestScore;
-        if (tryReverseComplement) {
-            string queryRevC = reverseComplement(query);
-            sw.Align(referencePos, cigar, reference, query);
-            if (sw.BestScore > bestScore) {
-                alignedReverse = true;
-                bestScore = sw.BestScore;
-                query = queryRevC;
-            }
-        }
-    }
- 
-    printf("%s %3u %f %s\n", cigar.c_str(), referencePos, bestScore, (alignedReverse ? "-" : "+"));
-
-    // optionally print out the alignment
-    if (print_alignment) {
-        int alignmentLength = 0;
-        int len;
-        string slen;
-        vector<pair<int, char> > cigarData;
-        for (string::iterator c = cigar.begin(); c != cigar.end(); ++c) {
-            switch (*c) {
-            case 'I':
-                len = atoi(slen.c_str());
-                slen.clear();
-                cigarData.push_back(make_pair(len, *c));
-                break;
-            case 'D':
-                len = atoi(slen.c_str());
-                alignmentLength += len;
-                slen.clear();
-                cigarData.push_back(make_pair(len, *c));
-                break;
-            case 'M':
-                len = atoi(slen.c_str());
-                alignmentLength += len;
-                slen.clear();
-                cigarData.push_back(make_pair(len, *c));
-                break;
-            case 'S':
-                len = atoi(slen.c_str());
-                slen.clear();
-                cigarData.push_back(make_pair(len, *c));
-                break;
-            default:
-                len = 0;
-                slen += *c;
-                break;
-            }
-        }
+    CAligners aligners(options);
 
-        string gapped_ref = string(reference).substr(referencePos, alignmentLength);
-        string gapped_query = string(query);
-
-        int refpos = 0;
-        int readpos = 0;
-        for (vector<pair<int, char> >::iterator c = cigarData.begin(); c != cigarData.end(); ++c) {
-            int len = c->first;
-            switch (c->second) {
-            case 'I':
-                gapped_ref.insert(refpos, string(len, '-'));
-                readpos += len;
-                refpos += len;
-                break;
-            case 'D':
-                gapped_query.insert(readpos, string(len, '-'));
-                refpos += len;
-                readpos += len;
-                break;
-            case 'M':
-                readpos += len;
-                refpos += len;
-                break;
-            case 'S':
-                readpos += len;
-                gapped_ref.insert(refpos, string(len, '*'));
-                refpos += len;
-                break;
-            default:
-                break;
-            }
-        }
+    CAlignmentJob job;
+    job.Reference = reference;
+    job.Query = query;
+    alignPair(options, aligners, job);
 
-        cout << gapped_ref << endl << gapped_query << endl;
-    }
+    printJob(options, job);
 
 	return 0;
 
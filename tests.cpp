@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "LeftAlign.h"
+#include "SmithWatermanGotoh.h"
+
+using namespace std;
+
+// regression tests for the aligners
+//
+// usage: tests
+//
+// runs every test and exits non-zero if any check failed
+
+static unsigned int numChecks = 0;
+static unsigned int numFailures = 0;
+
+// counts the check, reporting it if it failed
+static void check(const bool passed, const string& name, const string& detail) {
+    numChecks++;
+    if(passed) return;
+    numFailures++;
+    cerr << "FAILED: " << name << ": " << detail << endl;
+}
+
+// a cigar normalized by leftAlign until it stops changing, as stablyLeftAlign used to
+struct CNormalizationCase {
+    const char* Reference;
+    const char* Query;
+    const char* Cigar;
+    const char* Normalized;
+};
+
+static const CNormalizationCase normalizationCases[] = {
+    // indels settling in different orders used to split the insertion into I+M+D
+    { "CTGGAACACCCCCCCTTAC",     "CTGGAACAAACACCCCCCCCCCC", "8M4I5M5I5D1M", "4M4I4M5I6M" },
+    { "ACTTTGATCCAGAAAAACAATTA", "ACTTTGATCCAGAAATTACAA",   "15M4D5I3D1M",  "14M4D1M5I1M" },
+    { "TCTAATTCCAACACACGGCAA",   "TCTAATACACACGGCTAAA",     "6M4D9M3I1D1M", "6M4D9M3I1M" },
+    // a lone indel in a tandem repeat goes to its left end
+    { "GATTACACACACACAGATTA",    "GATTACACACACACACAGATTA",  "15M2I5M",      "4M2I16M" },
+};
+
+// normalizeIndels and stablyLeftAlign give the alignment of the leftAlign loop
+static void testNormalizeIndels(void) {
+
+    for(unsigned int k = 0; k < sizeof(normalizationCases) / sizeof(normalizationCases[0]); k++) {
+	const CNormalizationCase& c = normalizationCases[k];
+	const string query = c.Query;
+	const string reference = c.Reference;
+	const string name = string("normalize ") + c.Cigar;
+
+	LeftAlignWorkspace workspace;
+	vector<uint32_t> iterated, normalized;
+	packCIGAR(c.Cigar, iterated);
+	packCIGAR(c.Cigar, normalized);
+	int iteratedOffset = 0, normalizedOffset = 0;
+
+	int iterations = 20;
+	while(leftAlign(query.data(), query.length(), iterated, reference.data(), reference.length(), iteratedOffset, workspace) && --iterations > 0) { }
+	normalizeIndels(query.data(), query.length(), normalized, reference.data(), reference.length(), normalizedOffset, workspace);
+
+	string iteratedCigar, normalizedCigar;
+	formatCIGAR(iterated, iteratedCigar);
+	formatCIGAR(normalized, normalizedCigar);
+	check(iteratedCigar == c.Normalized, name, "leftAlign loop gave " + iteratedCigar);
+	check(normalizedCigar == c.Normalized && normalizedOffset == iteratedOffset, name, "normalizeIndels gave " + normalizedCigar);
+
+	string stableCigar = c.Cigar;
+	int stableOffset = 0;
+	const bool stable = stablyLeftAlign(query, stableCigar, reference, stableOffset);
+	check(stable && stableCigar == c.Normalized, name, "stablyLeftAlign gave " + stableCigar);
+    }
+}
+
+// stablyLeftAlign reports an alignment leftAlign had not settled within maxiterations calls
+static void testStablyLeftAlignIterations(void) {
+
+    const string reference = "CCGAGTGCAAAAAAATTTTT";
+    const string query     = "CCGAAAAAAATTTTT";
+
+    string cigar = "4M1I4D3M2D7M";
+    int offset = 0;
+    check(!stablyLeftAlign(query, cigar, reference, offset, 1), "stablyLeftAlign 4M1I4D3M2D7M", "stable after 1 iteration");
+
+    cigar = "4M1I4D3M2D7M";
+    offset = 0;
+    const bool stable = stablyLeftAlign(query, cigar, reference, offset);
+    check(stable && cigar == "3M5D12M", "stablyLeftAlign 4M1I4D3M2D7M", "gave " + cigar);
+}
+
+// a query sharing no base with the reference gives the empty alignment
+static void testEmptyAlignment(void) {
+
+    CSmithWatermanGotoh sw(10.0f, -9.0f, 15.0f, 6.66f);
+    CSmithWatermanAlignment alignment;
+    sw.Align(alignment, "AAAAAAAA", "TTTT");
+
+    check(alignment.Cigar.empty(), "empty alignment", "the cigar is not empty");
+    check(alignment.Score == 0.0f, "empty alignment", "the score is not 0");
+    check((alignment.ReferenceBegin == 0) && (alignment.ReferenceEnd == 0) && (alignment.QueryBegin == 0) && (alignment.QueryEnd == 0),
+	  "empty alignment", "the positions are not 0");
+    check((alignment.NumMismatches == 0) && (alignment.EditDistance == 0), "empty alignment", "the counts are not 0");
+
+    // reusing the result for a matching pair fills in every field again
+    sw.Align(alignment, "AAAAAAAA", "AAAA");
+    check((alignment.Cigar.size() == 1) && (alignment.QueryBegin == 0) && (alignment.QueryEnd == 3) && (alignment.ReferenceEnd == alignment.ReferenceBegin + 3),
+	  "empty alignment", "the next alignment is wrong");
+}
+
+// the available tests
+struct CTest {
+    const char* Name;
+    void (*Run)(void);
+};
+
+static const CTest tests[] = {
+    { "normalize-indels",            testNormalizeIndels },
+    { "stably-left-align-iterations", testStablyLeftAlignIterations },
+    { "empty-alignment",              testEmptyAlignment },
+};
+
+int main(void) {
+
+    for(unsigned int t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+	const unsigned int failuresBefore = numFailures;
+	tests[t].Run();
+	cout << tests[t].Name << ": " << ((numFailures == failuresBefore) ? "ok" : "FAILED") << endl;
+    }
+
+    cout << numChecks - numFailures << " of " << numChecks << " checks passed" << endl;
+    return (numFailures == 0) ? 0 : 1;
+}